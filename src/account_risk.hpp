@@ -0,0 +1,90 @@
+#ifndef ACCOUNT_RISK_HPP
+#define ACCOUNT_RISK_HPP
+
+#include "order.hpp"
+#include "arena.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace orderbook {
+
+// Per-account fill counters, kept by the matching engine itself
+struct AccountExposure {
+    int64_t position = 0;  // Net filled quantity: bought - sold
+    uint64_t bought = 0;
+    uint64_t sold = 0;
+    uint64_t position_limit = std::numeric_limits<uint64_t>::max(); // Max |position|
+};
+
+// Exposure table indexed directly by account ID, sized once
+// (BookConfig::max_accounts) so the match loop never allocates or hashes.
+// Account 0 means "no account": it is never checked or counted.
+class AccountRisk {
+public:
+    explicit AccountRisk(size_t max_accounts, Arena* arena = nullptr)
+        : accounts_(max_accounts, AccountExposure(), ArenaAllocator<AccountExposure>(arena)) {}
+
+    bool known(uint32_t account) const { return account == 0 || account < accounts_.size(); }
+
+    // Order entry: would filling all of order push its account's position
+    // past the limit? Open orders are not aggregated; each order is judged
+    // against the filled position alone.
+    bool within_limit(const Order& order) const {
+        if (order.account == 0) return true;
+        const AccountExposure& e = accounts_[order.account];
+        int64_t quantity = order.quantity;
+        int64_t projected = order.side == Side::Buy ? e.position + quantity : e.position - quantity;
+        uint64_t magnitude = static_cast<uint64_t>(projected < 0 ? -projected : projected);
+        return magnitude <= e.position_limit;
+    }
+
+    void record_fill(uint32_t account, Side side, uint32_t quantity) {
+        if (account == 0) return;
+        AccountExposure& e = accounts_[account];
+        if (side == Side::Buy) {
+            e.position += quantity;
+            e.bought += quantity;
+        } else {
+            e.position -= quantity;
+            e.sold += quantity;
+        }
+    }
+
+    // nullptr for account 0 or one out of range
+    const AccountExposure* exposure(uint32_t account) const {
+        return account != 0 && account < accounts_.size() ? &accounts_[account] : nullptr;
+    }
+
+    bool set_position_limit(uint32_t account, uint64_t limit) {
+        if (account == 0 || account >= accounts_.size()) return false;
+        accounts_[account].position_limit = limit;
+        return true;
+    }
+
+    // Visit (account, exposure) for every account with fills or a limit
+    template <typename F>
+    void for_each(F&& f) const {
+        for (uint32_t account = 1; account < accounts_.size(); account++) {
+            const AccountExposure& e = accounts_[account];
+            if (e.bought != 0 || e.sold != 0 || e.position_limit != AccountExposure().position_limit) {
+                f(account, e);
+            }
+        }
+    }
+
+    // Restore an account's counters (snapshot load); false if out of range
+    bool restore(uint32_t account, const AccountExposure& exposure) {
+        if (account == 0 || account >= accounts_.size()) return false;
+        accounts_[account] = exposure;
+        return true;
+    }
+
+private:
+    ArenaVector<AccountExposure> accounts_;
+};
+
+} // namespace orderbook
+
+#endif // ACCOUNT_RISK_HPP
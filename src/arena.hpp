@@ -0,0 +1,243 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace orderbook {
+
+// Arena usage, as reported by Arena::stats()
+struct ArenaStats {
+    size_t capacity = 0;    // Bytes reserved (and pre-faulted) up front
+    size_t reserved = 0;    // Bytes carved from the region so far (bump pointer)
+    size_t live = 0;        // Bytes currently allocated, region and overflow
+    size_t peak = 0;        // High-water mark of live
+    size_t allocations = 0; // Allocation calls served
+    size_t overflow = 0;    // Of those, served by the global heap (region full)
+    bool huge_pages = false; // Region is backed by explicit 2 MB pages
+};
+
+// One contiguous region for all of an engine's containers, reserved and
+// pre-faulted at construction so the trading day starts with every page
+// mapped.
+//
+// The region is mapped with 2 MB huge pages (MAP_HUGETLB) when asked and
+// available, otherwise with normal pages marked for transparent huge pages.
+// Blocks are carved off a bump pointer and recycled through free lists by
+// size class: 16-byte steps up to 256 bytes, powers of two up to 64 KiB,
+// and whole pages above that (reused only at the same size). Freed memory
+// stays in the arena; once the region is used up, allocations fall back to
+// the global heap and are counted as overflow.
+//
+// Not synchronized: an arena belongs to one thread, like the book that owns
+// it. Engines on different threads (e.g. MultiSymbolEngine shards) each
+// need their own, which BookConfig::arena_bytes gives them.
+class Arena {
+public:
+    static constexpr size_t kHugePage = size_t(2) << 20;
+
+    explicit Arena(size_t bytes, bool huge_pages = true) {
+        if (bytes == 0) return;
+        if (huge_pages) {
+#if defined(MAP_HUGETLB)
+            size_t rounded = (bytes + kHugePage - 1) & ~(kHugePage - 1);
+            void* base = ::mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) {
+                base_ = static_cast<uint8_t*>(base);
+                stats_.capacity = rounded;
+                stats_.huge_pages = true;
+            }
+#endif
+        }
+        if (!base_) {
+            void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED) return; // Everything overflows to the heap
+            base_ = static_cast<uint8_t*>(base);
+            stats_.capacity = bytes;
+#if defined(MADV_HUGEPAGE)
+            if (huge_pages) ::madvise(base_, bytes, MADV_HUGEPAGE);
+#endif
+        }
+        // Pre-fault: one write per page
+        size_t page = stats_.huge_pages ? kHugePage : static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        for (size_t offset = 0; offset < stats_.capacity; offset += page) {
+            static_cast<volatile uint8_t*>(base_)[offset] = 0;
+        }
+    }
+
+    ~Arena() {
+        if (base_) ::munmap(base_, stats_.capacity);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align) {
+        stats_.allocations++;
+        size_t size = block_size(bytes, align);
+        void* p = size ? take(size) : nullptr;
+        if (!p) {
+            stats_.overflow++;
+            p = ::operator new(bytes, std::align_val_t(align));
+            size = bytes;
+        }
+        stats_.live += size;
+        if (stats_.live > stats_.peak) stats_.peak = stats_.live;
+        return p;
+    }
+
+    // bytes and align as passed to allocate()
+    void deallocate(void* p, size_t bytes, size_t align) {
+        if (!owns(p)) {
+            stats_.live -= bytes;
+            ::operator delete(p, std::align_val_t(align));
+            return;
+        }
+        size_t size = block_size(bytes, align);
+        stats_.live -= size;
+        if (size > kMaxPow2) {
+            auto* block = static_cast<LargeBlock*>(p);
+            block->size = size;
+            block->next = large_;
+            large_ = block;
+        } else {
+            auto* block = static_cast<FreeBlock*>(p);
+            block->next = free_[size_class(size)];
+            free_[size_class(size)] = block;
+        }
+    }
+
+    bool owns(const void* p) const {
+        auto* b = static_cast<const uint8_t*>(p);
+        return base_ && b >= base_ && b < base_ + stats_.capacity;
+    }
+
+    const ArenaStats& stats() const { return stats_; }
+
+private:
+    static constexpr size_t kSmallStep = 16;
+    static constexpr size_t kMaxSmall = 256;
+    static constexpr size_t kMaxPow2 = size_t(64) << 10;
+    static constexpr size_t kMaxAlign = 64; // Larger alignments go to the heap
+    static constexpr size_t kPage = 4096;
+    static constexpr size_t kClasses = kMaxSmall / kSmallStep + 9; // 16 small + 512 B .. 64 KiB
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    struct LargeBlock {
+        LargeBlock* next;
+        size_t size;
+    };
+
+    uint8_t* base_ = nullptr;
+    size_t top_ = 0; // Bump offset into the region
+    FreeBlock* free_[kClasses] = {};
+    LargeBlock* large_ = nullptr;
+    ArenaStats stats_;
+
+    // Size of the block serving a request (0: not servable from the region).
+    // Every block is carved at the largest power of two dividing its size,
+    // capped at 64, so rounding a request up to a multiple of its alignment
+    // is enough to place it.
+    static size_t block_size(size_t bytes, size_t align) {
+        if (align > kMaxAlign) return 0;
+        size_t step = align > kSmallStep ? align : kSmallStep;
+        size_t size = bytes == 0 ? step : (bytes + step - 1) & ~(step - 1);
+        if (size <= kMaxSmall) return size;
+        if (size <= kMaxPow2) {
+            size_t pow2 = kMaxSmall * 2;
+            while (pow2 < size) pow2 <<= 1;
+            return pow2;
+        }
+        return (size + kPage - 1) & ~(kPage - 1);
+    }
+
+    static size_t block_align(size_t size) {
+        size_t low = size & (~size + 1);
+        return low < kMaxAlign ? low : kMaxAlign;
+    }
+
+    static size_t size_class(size_t size) {
+        if (size <= kMaxSmall) return size / kSmallStep - 1;
+        size_t c = kMaxSmall / kSmallStep;
+        for (size_t s = kMaxSmall * 2; s < size; s <<= 1) c++;
+        return c;
+    }
+
+    void* take(size_t size) {
+        if (size <= kMaxPow2) {
+            FreeBlock*& head = free_[size_class(size)];
+            if (head) {
+                FreeBlock* block = head;
+                head = block->next;
+                return block;
+            }
+        } else {
+            for (LargeBlock** link = &large_; *link; link = &(*link)->next) {
+                if ((*link)->size == size) {
+                    LargeBlock* block = *link;
+                    *link = block->next;
+                    return block;
+                }
+            }
+        }
+        size_t align = block_align(size);
+        size_t offset = (top_ + align - 1) & ~(align - 1);
+        if (offset + size > stats_.capacity) return nullptr;
+        top_ = offset + size;
+        stats_.reserved = top_;
+        return base_ + offset;
+    }
+};
+
+// Standard allocator drawing from an Arena; with no arena it is the global
+// heap, so containers default to their usual behaviour. It travels with the
+// container on copy, move and swap.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    Arena* arena = nullptr;
+
+    ArenaAllocator() noexcept = default;
+    explicit ArenaAllocator(Arena* a) noexcept : arena(a) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (!arena) return std::allocator<T>().allocate(n);
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!arena) {
+            std::allocator<T>().deallocate(p, n);
+        } else {
+            arena->deallocate(p, n * sizeof(T), alignof(T));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace orderbook
+
+#endif // ARENA_HPP
@@ -0,0 +1,171 @@
+#ifndef AUCTION_HPP
+#define AUCTION_HPP
+
+#include "arena.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace orderbook {
+
+// Outcome of an auction uncross (or of the price search alone)
+struct AuctionResult {
+    double price = 0;
+    uint64_t volume = 0;  // Executed (uncross) or executable (indicative)
+    uint64_t surplus = 0; // Quantity left unmatched at price on the heavier side
+};
+
+// In-place inclusive prefix sum: v[i] = v[0] + ... + v[i]. Four lanes at a
+// time on AVX2 (two on NEON): a shift-and-add scan inside the register, then
+// the running total of earlier blocks broadcast and added.
+inline void inclusive_scan(uint64_t* v, size_t n) {
+    size_t i = 0;
+    uint64_t carry = 0;
+#if defined(__AVX2__)
+    __m256i total = _mm256_setzero_si256();
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        // [a b c d] + [0 a b c] + [0 0 a a+b]
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x90), zero, 0x03));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x40), zero, 0x0F));
+        x = _mm256_add_epi64(x, total);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), x);
+        total = _mm256_permute4x64_epi64(x, 0xFF);
+    }
+    if (i > 0) carry = v[i - 1];
+#elif defined(__ARM_NEON)
+    uint64x2_t total = vdupq_n_u64(0);
+    const uint64x2_t zero = vdupq_n_u64(0);
+    for (; i + 2 <= n; i += 2) {
+        uint64x2_t x = vld1q_u64(v + i);
+        x = vaddq_u64(x, vextq_u64(zero, x, 1)); // [a b] + [0 a]
+        x = vaddq_u64(x, total);
+        vst1q_u64(v + i, x);
+        total = vdupq_laneq_u64(x, 1);
+    }
+    if (i > 0) carry = v[i - 1];
+#endif
+    for (; i < n; i++) {
+        carry += v[i];
+        v[i] = carry;
+    }
+}
+
+// Cumulative supply and demand over the crossed part of a book, one point
+// per price that has a level on either side, for finding the single price
+// that executes the most volume.
+//
+// Bids are added best first (descending), asks best first (ascending);
+// build() merges them onto one ascending price axis and runs two prefix
+// scans: supply(p) = asks at or below p, demand(p) = bids at or above p.
+// Only level aggregates are read, so hidden iceberg reserve is not counted
+// in the search (it still trades in the uncross). Buffers are kept between
+// auctions.
+template <typename Key>
+class AuctionCurves {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit AuctionCurves(Arena* arena = nullptr)
+        : bids_(ArenaAllocator<Point>(arena)), asks_(ArenaAllocator<Point>(arena)),
+          keys_(ArenaAllocator<Key>(arena)), prices_(ArenaAllocator<double>(arena)),
+          supply_(ArenaAllocator<uint64_t>(arena)), demand_(ArenaAllocator<uint64_t>(arena)),
+          bid_at_(ArenaAllocator<uint64_t>(arena)) {}
+
+    void clear() {
+        bids_.clear();
+        asks_.clear();
+        keys_.clear();
+        prices_.clear();
+        supply_.clear();
+        demand_.clear();
+        bid_at_.clear();
+    }
+
+    void add_bid(Key key, double price, uint64_t quantity) { bids_.push_back({key, price, quantity}); }
+    void add_ask(Key key, double price, uint64_t quantity) { asks_.push_back({key, price, quantity}); }
+
+    void build() {
+        size_t b = bids_.size(); // Walked from the back: lowest bid first
+        size_t a = 0;
+        while (b > 0 || a < asks_.size()) {
+            bool take_bid = a == asks_.size() || (b > 0 && bids_[b - 1].key <= asks_[a].key);
+            bool take_ask = b == 0 || (a < asks_.size() && asks_[a].key <= bids_[b - 1].key);
+            const Point& p = take_bid ? bids_[b - 1] : asks_[a];
+            keys_.push_back(p.key);
+            prices_.push_back(p.price);
+            demand_.push_back(take_bid ? bids_[b - 1].quantity : 0);
+            supply_.push_back(take_ask ? asks_[a].quantity : 0);
+            b -= take_bid;
+            a += take_ask;
+        }
+        size_t n = keys_.size();
+        if (n == 0) return;
+        inclusive_scan(supply_.data(), n);
+        // demand(i) = all bids - bids below point i = total - scan(i) + bid(i)
+        bid_at_.assign(demand_.begin(), demand_.end());
+        inclusive_scan(demand_.data(), n);
+        uint64_t total = demand_[n - 1];
+        for (size_t i = 0; i < n; i++) {
+            demand_[i] = total - demand_[i] + bid_at_[i];
+        }
+    }
+
+    size_t size() const { return keys_.size(); }
+    Key key(size_t i) const { return keys_[i]; }
+    double price(size_t i) const { return prices_[i]; }
+    uint64_t supply(size_t i) const { return supply_[i]; }
+    uint64_t demand(size_t i) const { return demand_[i]; }
+
+    // Point executing the most volume; ties go to the least surplus, then
+    // the price nearest reference, then the lower price. npos if nothing
+    // crosses.
+    size_t equilibrium(double reference) const {
+        size_t best = npos;
+        uint64_t best_volume = 0;
+        uint64_t best_surplus = 0;
+        double best_distance = 0;
+        for (size_t i = 0; i < keys_.size(); i++) {
+            uint64_t volume = std::min(demand_[i], supply_[i]);
+            uint64_t surplus = std::max(demand_[i], supply_[i]) - volume;
+            double distance = std::fabs(prices_[i] - reference);
+            if (volume == 0) continue;
+            if (best == npos || volume > best_volume ||
+                (volume == best_volume && (surplus < best_surplus ||
+                                           (surplus == best_surplus && distance < best_distance)))) {
+                best = i;
+                best_volume = volume;
+                best_surplus = surplus;
+                best_distance = distance;
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Point {
+        Key key;
+        double price;
+        uint64_t quantity;
+    };
+    ArenaVector<Point> bids_;
+    ArenaVector<Point> asks_;
+    ArenaVector<Key> keys_;
+    ArenaVector<double> prices_;
+    ArenaVector<uint64_t> supply_;
+    ArenaVector<uint64_t> demand_;
+    ArenaVector<uint64_t> bid_at_;
+};
+
+} // namespace orderbook
+
+#endif // AUCTION_HPP
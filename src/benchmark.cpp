@@ -1,161 +1,253 @@
 #include "matching_engine.hpp"
+#include "latency_histogram.hpp"
+#include "tsc.hpp"
+#include "workload.hpp"
+#include "instrumentation.hpp"
 #include <iostream>
 #include <vector>
 #include <algorithm>
 #include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 using namespace orderbook;
-using Clock = std::chrono::steady_clock;
-
-// Measure latency of a single operation in nanoseconds
-template<typename Func>
-long long measure_ns(Func&& func) {
-    auto start = Clock::now();
-    func();
-    auto end = Clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+// Usage: benchmark [--ops N] [--depth N] [--rate EVENTS_PER_SEC] [--paced] [--seed S]
+//                  [--clock steady|tsc|none] [--arena MIB]
+//
+// Each scenario pre-populates a deep book (untimed), then times every event
+// of its stream with the TSC, minus the timer's own overhead. With --paced,
+// events are released at their Poisson arrival times and latency runs from
+// the scheduled arrival, so queueing behind a slow event is counted.
+// Throughput is measured on a second, untimed pass over the same stream.
+// --clock picks the engine's order-stamping policy (engine_clock.hpp).
+// --arena gives each engine a pre-faulted arena of that size (arena.hpp).
+struct Options {
+    size_t operations = 500000;
+    size_t depth = 100000;
+    double rate = 1e6;
+    bool paced = false;
+    uint64_t seed = 42;
+    std::string clock = "steady";
+    size_t arena_mib = 0;
+};
+
+enum EventKind { Add, Cancel, Aggressive, kKinds };
+
+static EventKind kind_of(const Command& command) {
+    if (command.type == CommandType::Cancel) return Cancel;
+    return command.order.type == OrderType::Market ? Aggressive : Add;
 }
 
-// Calculate percentile from sorted vector
-double percentile(std::vector<long long>& sorted_data, double p) {
-    size_t idx = static_cast<size_t>(p * sorted_data.size());
-    if (idx >= sorted_data.size()) idx = sorted_data.size() - 1;
-    return static_cast<double>(sorted_data[idx]);
+static void print_header() {
+    std::cout << std::left << std::setw(18) << "  event" << std::right
+              << std::setw(9) << "count" << std::setw(8) << "mean" << std::setw(8) << "p50"
+              << std::setw(8) << "p90" << std::setw(8) << "p99" << std::setw(9) << "p99.9"
+              << std::setw(9) << "p99.99" << std::setw(9) << "max" << "   (ns)" << std::endl;
 }
 
-int main() {
-    const int NUM_OPERATIONS = 100000;
-    
-    std::cout << "=== ORDER BOOK LATENCY BENCHMARK ===" << std::endl;
-    std::cout << "Operations per test: " << NUM_OPERATIONS << std::endl;
+static void print_row(const std::string& name, const LatencyHistogram& h) {
+    std::cout << std::left << std::setw(18) << ("  " + name) << std::right << std::fixed
+              << std::setprecision(0) << std::setw(9) << h.count() << std::setw(8) << h.mean()
+              << std::setw(8) << h.percentile(0.50) << std::setw(8) << h.percentile(0.90)
+              << std::setw(8) << h.percentile(0.99) << std::setw(9) << h.percentile(0.999)
+              << std::setw(9) << h.percentile(0.9999) << std::setw(9) << h.max() << std::endl;
+}
+
+// Built with -DORDERBOOK_INSTRUMENT: cycles per stage and message kind,
+// summed over every scenario run so far (pre-population included)
+static void print_stages() {
+    const char* stage_names[] = {"dispatch", "level lookup", "fill loop", "book insert", "index update"};
+    const char* message_names[] = {"market", "limit", "stop", "cancel", "replace"};
+    auto row = [](const char* name, const CycleSnapshot& s) {
+        std::cout << std::left << std::setw(18) << (std::string("  ") + name) << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(11) << s.count << std::setw(8) << s.mean()
+                  << std::setw(8) << s.percentile(0.50) << std::setw(8) << s.percentile(0.99)
+                  << std::setw(10) << s.max << std::endl;
+    };
+    std::cout << "Hot-path stages" << std::endl;
+    std::cout << std::left << std::setw(18) << "  stage" << std::right << std::setw(11) << "count"
+              << std::setw(8) << "mean" << std::setw(8) << "p50<=" << std::setw(8) << "p99<="
+              << std::setw(10) << "max" << "   (cycles)" << std::endl;
+    for (size_t i = 0; i < static_cast<size_t>(Stage::kCount); i++) {
+        row(stage_names[i], read_stage(static_cast<Stage>(i)));
+    }
+    for (size_t i = 0; i < static_cast<size_t>(MessageKind::kCount); i++) {
+        CycleSnapshot s = read_message(static_cast<MessageKind>(i));
+        if (s.count > 0) row(message_names[i], s);
+    }
     std::cout << std::endl;
+}
+
+template <typename PriceLevels, typename Clock>
+MatchingEngine<PriceLevels, Clock> prepared_engine(const Workload& workload, const BookConfig& config) {
+    MatchingEngine<PriceLevels, Clock> engine(config);
+    for (const Command& command : workload.setup) {
+        engine.apply(command, [](const Trade&) {});
+    }
+    return engine;
+}
+
+template <typename PriceLevels, typename Clock>
+void run_scenario(const std::string& name, WorkloadConfig wconfig, const Options& options,
+                  const TscTimer& timer) {
+    Workload workload = generate_workload(wconfig);
+    size_t total_ids = workload.setup.size() + workload.events.size() + 1;
+
+    // Sequential order IDs, book sized for every order to rest at once
+    BookConfig config;
+    config.order_pool_capacity = total_ids;
+    config.direct_index_window = total_ids;
+    config.arena_bytes = options.arena_mib << 20;
+
+    uint64_t trades = 0;
+    auto sink = [&](const Trade&) { trades++; };
 
-    // Benchmark 1: Add limit orders
+    // Timed pass
+    LatencyHistogram all;
+    LatencyHistogram by_kind[kKinds];
+    ArenaStats arena;
     {
-        std::vector<long long> latencies;
-        latencies.reserve(NUM_OPERATIONS);
-        MatchingEngine engine;
-        
-        for (int i = 0; i < NUM_OPERATIONS; i++) {
-            Order order;
-            order.id = i;
-            order.type = OrderType::Limit;
-            order.side = (i % 2 == 0) ? Side::Buy : Side::Sell;
-            order.price = 100.0 + (i % 100); // Spread across 100 price levels
-            order.quantity = 10;
-            
-            long long ns = measure_ns([&]() {
-                engine.process_order(order);
-            });
-            latencies.push_back(ns);
+        auto engine = prepared_engine<PriceLevels, Clock>(workload, config);
+        uint64_t origin = tsc_now();
+        for (size_t i = 0; i < workload.events.size(); i++) {
+            const Command& command = workload.events[i];
+            uint64_t start;
+            if (options.paced) {
+                start = origin + static_cast<uint64_t>(workload.arrival_ns[i] / timer.ns_per_tick);
+                while (tsc_now() < start) {
+                }
+            } else {
+                start = tsc_now();
+            }
+            engine.apply(command, sink);
+            uint64_t ns = timer.elapsed_ns(start, tsc_now());
+            all.record(ns);
+            by_kind[kind_of(command)].record(ns);
         }
-        
-        std::sort(latencies.begin(), latencies.end());
-        
-        double median = percentile(latencies, 0.50);
-        double p99 = percentile(latencies, 0.99);
-        double mean = 0;
-        for (auto l : latencies) mean += l;
-        mean /= latencies.size();
-        
-        std::cout << "ADD LIMIT ORDER:" << std::endl;
-        std::cout << "  Median:  " << std::fixed << std::setprecision(0) << median << " ns (" << median/1000 << " μs)" << std::endl;
-        std::cout << "  Mean:    " << mean << " ns (" << mean/1000 << " μs)" << std::endl;
-        std::cout << "  P99:     " << p99 << " ns (" << p99/1000 << " μs)" << std::endl;
-        std::cout << std::endl;
+        arena = engine.arena_stats();
     }
 
-    // Benchmark 2: Matching orders (crossing)
+    // Untimed pass for throughput
+    double seconds;
     {
-        std::vector<long long> latencies;
-        latencies.reserve(NUM_OPERATIONS);
-        
-        for (int i = 0; i < NUM_OPERATIONS; i++) {
-            MatchingEngine engine;
-            
-            // Pre-populate with a sell order
-            Order sell;
-            sell.id = 1;
-            sell.type = OrderType::Limit;
-            sell.side = Side::Sell;
-            sell.price = 100.0;
-            sell.quantity = 10;
-            engine.process_order(sell);
-            
-            // Measure matching buy
-            Order buy;
-            buy.id = 2;
-            buy.type = OrderType::Limit;
-            buy.side = Side::Buy;
-            buy.price = 100.0;
-            buy.quantity = 10;
-            
-            long long ns = measure_ns([&]() {
-                engine.process_order(buy);
-            });
-            latencies.push_back(ns);
+        auto engine = prepared_engine<PriceLevels, Clock>(workload, config);
+        auto start = std::chrono::steady_clock::now();
+        for (const Command& command : workload.events) {
+            engine.apply(command, sink);
         }
-        
-        std::sort(latencies.begin(), latencies.end());
-        
-        double median = percentile(latencies, 0.50);
-        double p99 = percentile(latencies, 0.99);
-        double mean = 0;
-        for (auto l : latencies) mean += l;
-        mean /= latencies.size();
-        
-        std::cout << "MATCH ORDER (crossing):" << std::endl;
-        std::cout << "  Median:  " << std::fixed << std::setprecision(0) << median << " ns (" << median/1000 << " μs)" << std::endl;
-        std::cout << "  Mean:    " << mean << " ns (" << mean/1000 << " μs)" << std::endl;
-        std::cout << "  P99:     " << p99 << " ns (" << p99/1000 << " μs)" << std::endl;
-        std::cout << std::endl;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
 
-    // Benchmark 3: Cancel orders
-    {
-        std::vector<long long> latencies;
-        latencies.reserve(NUM_OPERATIONS);
-        MatchingEngine engine;
-        
-        // Pre-populate
-        for (int i = 0; i < NUM_OPERATIONS; i++) {
-            Order order;
-            order.id = i;
-            order.type = OrderType::Limit;
-            order.side = Side::Buy;
-            order.price = 100.0 + (i % 100);
-            order.quantity = 10;
-            engine.process_order(order);
+    std::cout << name << ": " << std::fixed << std::setprecision(2)
+              << workload.events.size() / seconds / 1e6 << " M events/s, "
+              << workload.setup.size() << " orders resting at start" << std::endl;
+    if (arena.capacity > 0) {
+        std::cout << "  arena: " << (arena.peak >> 20) << " of " << (arena.capacity >> 20) << " MiB at peak, "
+                  << arena.overflow << " heap overflows" << (arena.huge_pages ? ", 2 MB pages" : "") << std::endl;
+    }
+    print_header();
+    const char* kind_names[kKinds] = {"add", "cancel", "aggressive"};
+    size_t kinds_seen = 0;
+    for (const auto& h : by_kind) kinds_seen += h.count() > 0;
+    if (kinds_seen > 1) {
+        for (int k = 0; k < kKinds; k++) {
+            if (by_kind[k].count() > 0) print_row(kind_names[k], by_kind[k]);
         }
-        
-        // Measure cancels
-        for (int i = 0; i < NUM_OPERATIONS; i++) {
-            long long ns = measure_ns([&]() {
-                engine.cancel_order(i);
-            });
-            latencies.push_back(ns);
+    }
+    print_row("all", all);
+    std::cout << std::endl;
+}
+
+template <typename PriceLevels, typename Clock>
+void run_suite(const char* label, const Options& options, const TscTimer& timer) {
+    std::cout << "--- " << label << " ---" << std::endl << std::endl;
+
+    WorkloadConfig base;
+    base.operations = options.operations;
+    base.book_depth = options.depth;
+    base.arrival_rate = options.rate;
+    base.seed = options.seed;
+
+    // Passive adds only: Zipfian around the touch of a deep book
+    WorkloadConfig add = base;
+    add.add_ratio = 1.0;
+    add.cancel_ratio = 0.0;
+    run_scenario<PriceLevels, Clock>("ADD (passive)", add, options, timer);
+
+    // Cancels of random resting orders
+    WorkloadConfig cancel = base;
+    cancel.book_depth = std::max(base.book_depth, base.operations);
+    cancel.add_ratio = 0.0;
+    cancel.cancel_ratio = 1.0;
+    run_scenario<PriceLevels, Clock>("CANCEL", cancel, options, timer);
+
+    // Market orders against a book kept full by passive adds
+    WorkloadConfig match = base;
+    match.add_ratio = 0.75;
+    match.cancel_ratio = 0.0;
+    match.aggressive_multiplier = 3;
+    run_scenario<PriceLevels, Clock>("MATCH (with refill)", match, options, timer);
+
+    // Realistic mix: mostly adds and cancels, a few aggressive orders
+    run_scenario<PriceLevels, Clock>("MIXED (60/35/5)", base, options, timer);
+}
+
+template <typename Clock>
+void run_stores(const Options& options, const TscTimer& timer) {
+    run_suite<MapPriceLevels, Clock>("MapPriceLevels (std::map)", options, timer);
+    run_suite<TickLadderPriceLevels, Clock>("TickLadderPriceLevels", options, timer);
+    run_suite<HybridPriceLevels, Clock>("HybridPriceLevels (window + map)", options, timer);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+        if (!std::strcmp(argv[i], "--ops")) options.operations = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--depth")) options.depth = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--rate")) options.rate = std::strtod(next(), nullptr);
+        else if (!std::strcmp(argv[i], "--seed")) options.seed = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--paced")) options.paced = true;
+        else if (!std::strcmp(argv[i], "--clock")) options.clock = next();
+        else if (!std::strcmp(argv[i], "--arena")) options.arena_mib = std::strtoull(next(), nullptr, 10);
+        else {
+            options.clock.clear();
+            break;
         }
-        
-        std::sort(latencies.begin(), latencies.end());
-        
-        double median = percentile(latencies, 0.50);
-        double p99 = percentile(latencies, 0.99);
-        double mean = 0;
-        for (auto l : latencies) mean += l;
-        mean /= latencies.size();
-        
-        std::cout << "CANCEL ORDER:" << std::endl;
-        std::cout << "  Median:  " << std::fixed << std::setprecision(0) << median << " ns (" << median/1000 << " μs)" << std::endl;
-        std::cout << "  Mean:    " << mean << " ns (" << mean/1000 << " μs)" << std::endl;
-        std::cout << "  P99:     " << p99 << " ns (" << p99/1000 << " μs)" << std::endl;
-        std::cout << std::endl;
+    }
+    if (options.clock != "steady" && options.clock != "tsc" && options.clock != "none") {
+        std::cerr << "usage: " << argv[0] << " [--ops N] [--depth N] [--rate EVENTS_PER_SEC] [--paced] [--seed S]"
+                  << " [--clock steady|tsc|none] [--arena MIB]" << std::endl;
+        return 1;
+    }
+
+    TscTimer timer = TscTimer::calibrate();
+
+    std::cout << "=== ORDER BOOK LATENCY BENCHMARK ===" << std::endl;
+    std::cout << "Events per scenario: " << options.operations
+              << ", pre-populated depth: " << options.depth
+              << (options.paced ? ", paced at " : ", back-to-back (rate ")
+              << options.rate << (options.paced ? " events/s" : " events/s unused)") << std::endl;
+    std::cout << "Timer: " << std::setprecision(3) << timer.ns_per_tick << " ns/tick, overhead "
+              << timer.overhead_ticks << " ticks subtracted, engine clock: " << options.clock << std::endl;
+    std::cout << std::endl;
+
+    if (options.clock == "tsc") {
+        run_stores<TscClock>(options, timer);
+    } else if (options.clock == "none") {
+        run_stores<NoClock>(options, timer);
+    } else {
+        run_stores<SteadyClock>(options, timer);
+    }
+    if (kInstrumented) {
+        print_stages();
     }
 
-    // Summary
     std::cout << "=== BENCHMARK COMPLETE ===" << std::endl;
-    std::cout << "Hardware: Apple Silicon (arm64)" << std::endl;
-    std::cout << "Compiler: Apple clang 15.0.0" << std::endl;
+    std::cout << "Compiler: " << __VERSION__ << std::endl;
     std::cout << "Standard: C++17" << std::endl;
-    
+
     return 0;
 }
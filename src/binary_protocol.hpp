@@ -0,0 +1,449 @@
+#ifndef BINARY_PROTOCOL_HPP
+#define BINARY_PROTOCOL_HPP
+
+#include "matching_engine.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace orderbook {
+
+// Fixed-layout little-endian order-entry protocol (ITCH/OUCH style).
+//
+// Every message is framed as
+//     u16 length   bytes that follow this field (type + body)
+//     u8  type
+//     body         fixed size per type
+// Prices are signed fixed point with 4 implied decimals (1000100 = 100.01).
+// Sides are 'B' / 'S'.
+//
+// Inbound (order entry)
+//   'A' AddOrder      u64 order_id, u8 side, u32 quantity, i64 price   (limit)
+//   'E' ExecuteOrder  u64 order_id, u8 side, u32 quantity              (market)
+//   'X' CancelOrder   u64 order_id
+//   'U' ReplaceOrder  u64 order_id, u32 quantity, i64 price
+//   'O' EnterOrder    u64 order_id, u8 side, u8 type, u8 tif, u8 flags,
+//                     u8 stp, u32 quantity, i64 price, i64 stop_price,
+//                     u32 display_quantity, u32 account
+//                     (any order: stops, time in force, post-only (flags
+//                     bit 0), icebergs, account and self-trade policy;
+//                     type / tif / stp are the enum values)
+//   'S' TimeMark      u64 nanoseconds since capture start (pacing for
+//                     recorded captures; no engine effect, no report)
+// Outbound
+//   'T' Trade           u64 buy_order_id, u64 sell_order_id, u32 quantity, i64 price
+//   'R' ExecutionReport u64 order_id, u8 status, u32 executed, u32 leaves
+//
+// encode_order() picks 'A' / 'E' for plain limit and market orders and 'O'
+// for anything else, so a journal of its output replays every order
+// attribute. Calls made on the engine directly (mass_cancel, auctions,
+// position limits) have no message and are not journaled.
+namespace wire {
+
+constexpr int64_t kPriceScale = 10000;
+constexpr size_t kHeaderSize = 3; // u16 length + u8 type
+
+enum MessageType : uint8_t {
+    AddOrder = 'A',
+    ExecuteOrder = 'E',
+    CancelOrder = 'X',
+    ReplaceOrder = 'U',
+    EnterOrder = 'O',
+    TimeMark = 'S',
+    TradeReport = 'T',
+    ExecutionReport = 'R'
+};
+
+// Body sizes (excluding header)
+constexpr size_t kAddOrderSize = 21;
+constexpr size_t kExecuteOrderSize = 13;
+constexpr size_t kCancelOrderSize = 8;
+constexpr size_t kReplaceOrderSize = 20;
+constexpr size_t kEnterOrderSize = 41;
+constexpr size_t kTimeMarkSize = 8;
+constexpr size_t kTradeSize = 28;
+constexpr size_t kExecutionReportSize = 17;
+
+// Endianness-correct unaligned loads/stores. memcpy compiles to a single
+// move; the swap is compiled out on little-endian hosts.
+template <typename T>
+T load_le(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (sizeof(T) == 2) value = static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(value)));
+    if constexpr (sizeof(T) == 4) value = static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(value)));
+    if constexpr (sizeof(T) == 8) value = static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(value)));
+#endif
+    return value;
+}
+
+template <typename T>
+void store_le(uint8_t* p, T value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (sizeof(T) == 2) value = static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(value)));
+    if constexpr (sizeof(T) == 4) value = static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(value)));
+    if constexpr (sizeof(T) == 8) value = static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(value)));
+#endif
+    std::memcpy(p, &value, sizeof(T));
+}
+
+inline double decode_price(int64_t fixed) { return static_cast<double>(fixed) / kPriceScale; }
+inline int64_t encode_price(double price) { return std::llround(price * kPriceScale); }
+inline Side decode_side(uint8_t side) { return side == 'B' ? Side::Buy : Side::Sell; }
+inline uint8_t encode_side(Side side) { return side == Side::Buy ? 'B' : 'S'; }
+
+// Zero-copy views over a message body (p points just past the header)
+struct AddOrderView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+    Side side() const { return decode_side(p[8]); }
+    uint32_t quantity() const { return load_le<uint32_t>(p + 9); }
+    double price() const { return decode_price(load_le<int64_t>(p + 13)); }
+};
+
+struct ExecuteOrderView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+    Side side() const { return decode_side(p[8]); }
+    uint32_t quantity() const { return load_le<uint32_t>(p + 9); }
+};
+
+struct CancelOrderView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+};
+
+struct ReplaceOrderView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+    uint32_t quantity() const { return load_le<uint32_t>(p + 8); }
+    double price() const { return decode_price(load_le<int64_t>(p + 12)); }
+};
+
+struct EnterOrderView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+    Side side() const { return decode_side(p[8]); }
+    uint8_t type() const { return p[9]; }
+    uint8_t tif() const { return p[10]; }
+    bool post_only() const { return (p[11] & 1) != 0; }
+    uint8_t stp() const { return p[12]; }
+    uint32_t quantity() const { return load_le<uint32_t>(p + 13); }
+    double price() const { return decode_price(load_le<int64_t>(p + 17)); }
+    double stop_price() const { return decode_price(load_le<int64_t>(p + 25)); }
+    uint32_t display_quantity() const { return load_le<uint32_t>(p + 33); }
+    uint32_t account() const { return load_le<uint32_t>(p + 37); }
+
+    // False if type, tif or stp is out of range
+    bool to_order(Order& order) const {
+        if (type() > static_cast<uint8_t>(OrderType::StopLimit) ||
+            tif() > static_cast<uint8_t>(TimeInForce::FOK) ||
+            stp() > static_cast<uint8_t>(SelfTradePolicy::DecrementBoth)) {
+            return false;
+        }
+        order.id = order_id();
+        order.type = static_cast<OrderType>(type());
+        order.side = side();
+        order.price = price();
+        order.quantity = quantity();
+        order.display_quantity = display_quantity();
+        order.tif = static_cast<TimeInForce>(tif());
+        order.post_only = post_only();
+        order.stop_price = stop_price();
+        order.account = account();
+        order.stp = static_cast<SelfTradePolicy>(stp());
+        return true;
+    }
+};
+
+struct TimeMarkView {
+    const uint8_t* p;
+    uint64_t nanoseconds() const { return load_le<uint64_t>(p); }
+};
+
+struct TradeView {
+    const uint8_t* p;
+    uint64_t buy_order_id() const { return load_le<uint64_t>(p); }
+    uint64_t sell_order_id() const { return load_le<uint64_t>(p + 8); }
+    uint32_t quantity() const { return load_le<uint32_t>(p + 16); }
+    double price() const { return decode_price(load_le<int64_t>(p + 20)); }
+};
+
+struct ExecutionReportView {
+    const uint8_t* p;
+    uint64_t order_id() const { return load_le<uint64_t>(p); }
+    OrderStatus status() const { return static_cast<OrderStatus>(p[8]); }
+    uint32_t executed() const { return load_le<uint32_t>(p + 9); }
+    uint32_t leaves() const { return load_le<uint32_t>(p + 13); }
+};
+
+// Encoders: write one framed message at out, return its total size.
+// The caller guarantees room for kHeaderSize + body size.
+inline size_t write_header(uint8_t* out, MessageType type, size_t body) {
+    store_le<uint16_t>(out, static_cast<uint16_t>(1 + body));
+    out[2] = type;
+    return kHeaderSize + body;
+}
+
+inline size_t encode_add_order(uint8_t* out, uint64_t id, Side side, uint32_t quantity, double price) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, id);
+    p[8] = encode_side(side);
+    store_le<uint32_t>(p + 9, quantity);
+    store_le<int64_t>(p + 13, encode_price(price));
+    return write_header(out, AddOrder, kAddOrderSize);
+}
+
+inline size_t encode_execute_order(uint8_t* out, uint64_t id, Side side, uint32_t quantity) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, id);
+    p[8] = encode_side(side);
+    store_le<uint32_t>(p + 9, quantity);
+    return write_header(out, ExecuteOrder, kExecuteOrderSize);
+}
+
+inline size_t encode_cancel_order(uint8_t* out, uint64_t id) {
+    store_le<uint64_t>(out + kHeaderSize, id);
+    return write_header(out, CancelOrder, kCancelOrderSize);
+}
+
+inline size_t encode_replace_order(uint8_t* out, uint64_t id, uint32_t quantity, double price) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, id);
+    store_le<uint32_t>(p + 8, quantity);
+    store_le<int64_t>(p + 12, encode_price(price));
+    return write_header(out, ReplaceOrder, kReplaceOrderSize);
+}
+
+inline size_t encode_enter_order(uint8_t* out, const Order& order) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, order.id);
+    p[8] = encode_side(order.side);
+    p[9] = static_cast<uint8_t>(order.type);
+    p[10] = static_cast<uint8_t>(order.tif);
+    p[11] = order.post_only ? 1 : 0;
+    p[12] = static_cast<uint8_t>(order.stp);
+    store_le<uint32_t>(p + 13, order.quantity);
+    store_le<int64_t>(p + 17, encode_price(order.price));
+    store_le<int64_t>(p + 25, encode_price(order.stop_price));
+    store_le<uint32_t>(p + 33, order.display_quantity);
+    store_le<uint32_t>(p + 37, order.account);
+    return write_header(out, EnterOrder, kEnterOrderSize);
+}
+
+// Smallest message that carries all of order (room for kEnterOrderSize)
+inline size_t encode_order(uint8_t* out, const Order& order) {
+    bool plain = order.tif == TimeInForce::GTC && !order.post_only && order.display_quantity == 0 &&
+                 order.account == 0 && order.stp == SelfTradePolicy::None;
+    if (plain && order.type == OrderType::Limit) {
+        return encode_add_order(out, order.id, order.side, order.quantity, order.price);
+    }
+    if (plain && order.type == OrderType::Market) {
+        return encode_execute_order(out, order.id, order.side, order.quantity);
+    }
+    return encode_enter_order(out, order);
+}
+
+inline size_t encode_time_mark(uint8_t* out, uint64_t nanoseconds) {
+    store_le<uint64_t>(out + kHeaderSize, nanoseconds);
+    return write_header(out, TimeMark, kTimeMarkSize);
+}
+
+inline size_t encode_trade(uint8_t* out, const Trade& trade) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, trade.buy_order_id);
+    store_le<uint64_t>(p + 8, trade.sell_order_id);
+    store_le<uint32_t>(p + 16, trade.quantity);
+    store_le<int64_t>(p + 20, encode_price(trade.price));
+    return write_header(out, TradeReport, kTradeSize);
+}
+
+inline size_t encode_execution_report(uint8_t* out, uint64_t id, OrderStatus status,
+                                      uint32_t executed, uint32_t leaves) {
+    uint8_t* p = out + kHeaderSize;
+    store_le<uint64_t>(p, id);
+    p[8] = static_cast<uint8_t>(status);
+    store_le<uint32_t>(p + 9, executed);
+    store_le<uint32_t>(p + 13, leaves);
+    return write_header(out, ExecutionReport, kExecutionReportSize);
+}
+
+// Writes the outbound Trade / ExecutionReport stream for decode() into a
+// caller-owned buffer. Messages that do not fit are counted in dropped.
+struct OutputEncoder {
+    uint8_t* data;
+    size_t capacity;
+    size_t size = 0;
+    size_t dropped = 0;
+
+    OutputEncoder(uint8_t* buffer, size_t bytes) : data(buffer), capacity(bytes) {}
+
+    void on_trade(const Trade& trade) {
+        if (room(kTradeSize)) size += encode_trade(data + size, trade);
+    }
+
+    void on_report(uint64_t id, OrderStatus status, uint32_t executed, uint32_t leaves) {
+        if (room(kExecutionReportSize)) {
+            size += encode_execution_report(data + size, id, status, executed, leaves);
+        }
+    }
+
+private:
+    bool room(size_t body) {
+        if (size + kHeaderSize + body <= capacity) return true;
+        dropped++;
+        return false;
+    }
+};
+
+// Handler for decode() that discards trades and reports (e.g. on replay)
+struct NullHandler {
+    void on_trade(const Trade&) {}
+    void on_report(uint64_t, OrderStatus, uint32_t, uint32_t) {}
+};
+
+// Trade sink for decode(): forwards fills to the handler, counts those of
+// the order being entered, and reports each stop that order triggers.
+// Leaves are read back from the book, so they are right even when a
+// triggered stop trades with the order after it rests.
+template <typename Engine, typename Handler>
+struct Reporter {
+    Engine& engine;
+    Handler& handler;
+    uint64_t id;
+    uint32_t executed = 0;
+
+    void operator()(const Trade& trade) {
+        if (trade.buy_order_id == id || trade.sell_order_id == id) {
+            executed += trade.quantity;
+        }
+        handler.on_trade(trade);
+    }
+
+    void on_triggered(const Order& stop, OrderStatus status, uint32_t stop_executed) {
+        report(stop.id, status, stop_executed);
+    }
+
+    void report(uint64_t order_id, OrderStatus status, uint32_t order_executed) {
+        uint32_t leaves = 0;
+        if (status == OrderStatus::Resting) {
+            auto resting = engine.book().find_order(order_id);
+            leaves = resting ? resting->quantity : 0;
+        }
+        handler.on_report(order_id, status, order_executed, leaves);
+    }
+};
+
+// Bytes of [data, data + size) covered by complete messages, i.e. what
+// decode() would consume
+inline size_t complete_size(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    while (size - pos >= kHeaderSize) {
+        size_t length = load_le<uint16_t>(data + pos);
+        if (size - pos < 2 + length) {
+            break;
+        }
+        pos += 2 + length;
+    }
+    return pos;
+}
+
+// Decode every complete message in [data, data + size) and apply it to
+// engine straight from the receive buffer. handler.on_trade(trade) gets each
+// fill and handler.on_report(id, status, executed, leaves) one report per
+// order-entry message (TimeMark has none), plus one for each stop that
+// message triggers, sent as the stop completes. Unknown or short messages are
+// skipped by their length.
+// Returns the bytes consumed; a trailing partial message is left for the
+// next call.
+template <typename Engine, typename Handler>
+size_t decode(const uint8_t* data, size_t size, Engine& engine, Handler& handler) {
+    size_t pos = 0;
+    while (size - pos >= kHeaderSize) {
+        size_t length = load_le<uint16_t>(data + pos);
+        if (size - pos < 2 + length) {
+            break; // Partial message
+        }
+        if (length == 0) {
+            pos += 2; // Empty frame
+            continue;
+        }
+        const uint8_t* body = data + pos + kHeaderSize;
+        size_t body_size = length - 1;
+        uint8_t type = data[pos + 2];
+        pos += 2 + length;
+
+        // Run one order through the engine and report its outcome, and that
+        // of every stop it triggers
+        auto submit = [&](Order& order) {
+            Reporter<Engine, Handler> reporter{engine, handler, order.id};
+            OrderStatus status = engine.process_order(order, reporter);
+            reporter.report(order.id, status, reporter.executed);
+        };
+
+        switch (type) {
+        case AddOrder: {
+            if (body_size < kAddOrderSize) break;
+            AddOrderView view{body};
+            Order order;
+            order.id = view.order_id();
+            order.type = OrderType::Limit;
+            order.side = view.side();
+            order.quantity = view.quantity();
+            order.price = view.price();
+            submit(order);
+            break;
+        }
+        case ExecuteOrder: {
+            if (body_size < kExecuteOrderSize) break;
+            ExecuteOrderView view{body};
+            Order order;
+            order.id = view.order_id();
+            order.type = OrderType::Market;
+            order.side = view.side();
+            order.quantity = view.quantity();
+            order.price = 0.0;
+            submit(order);
+            break;
+        }
+        case EnterOrder: {
+            if (body_size < kEnterOrderSize) break;
+            EnterOrderView view{body};
+            Order order;
+            if (!view.to_order(order)) {
+                handler.on_report(view.order_id(), OrderStatus::Rejected, 0, 0);
+                break;
+            }
+            submit(order);
+            break;
+        }
+        case CancelOrder: {
+            if (body_size < kCancelOrderSize) break;
+            CancelOrderView view{body};
+            bool ok = engine.cancel_order(view.order_id());
+            handler.on_report(view.order_id(), ok ? OrderStatus::Cancelled : OrderStatus::Rejected, 0, 0);
+            break;
+        }
+        case ReplaceOrder: {
+            if (body_size < kReplaceOrderSize) break;
+            ReplaceOrderView view{body};
+            Reporter<Engine, Handler> reporter{engine, handler, view.order_id()};
+            OrderStatus status = engine.replace_order(view.order_id(), view.price(), view.quantity(), reporter);
+            reporter.report(view.order_id(), status, reporter.executed);
+            break;
+        }
+        case TimeMark:
+            break; // Pacing only
+        default:
+            break; // Unknown type: skipped
+        }
+    }
+    return pos;
+}
+
+} // namespace wire
+} // namespace orderbook
+
+#endif // BINARY_PROTOCOL_HPP
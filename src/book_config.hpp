@@ -0,0 +1,35 @@
+#ifndef BOOK_CONFIG_HPP
+#define BOOK_CONFIG_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace orderbook {
+
+class Arena; // arena.hpp
+
+// Construction-time parameters for an order book.
+// Each price-level store reads only the fields it needs; the std::map store
+// ignores all of them.
+struct BookConfig {
+    double tick_size = 0.01;             // Minimum price increment
+    double reference_price = 100.0;      // Tick ladder is centered on this price
+    uint32_t ladder_levels = 1 << 16;    // Number of ticks covered by the ladder
+    uint32_t window_levels = 1024;       // Hybrid store: dense ticks kept around the touch
+    size_t order_pool_capacity = 4096;   // Expected live orders: sizes the pool and id index
+    size_t direct_index_window = 0;      // Ring for sequential order IDs (0 = hash only)
+    bool publish_l2 = false;             // Record L2 deltas (see market_data.hpp)
+    bool state_hash = false;             // Maintain OrderBook::state_hash() (replicas)
+    uint32_t max_stop_triggers = 16;     // Stops released per engine call; the rest wait
+    uint32_t max_accounts = 256;         // Account IDs 1..max_accounts-1 (see account_risk.hpp)
+    size_t arena_bytes = 0;              // MatchingEngine: own arena of this size (0 = global heap)
+    bool huge_pages = true;              // Back that arena with 2 MB pages when available
+    // Containers allocate from here (set by MatchingEngine). An Arena is not
+    // synchronized: share one only among engines driven by a single thread
+    // (MultiSymbolEngine clears it; use arena_bytes there)
+    Arena* arena = nullptr;
+};
+
+} // namespace orderbook
+
+#endif // BOOK_CONFIG_HPP
@@ -0,0 +1,400 @@
+#ifndef BOOK_SNAPSHOT_HPP
+#define BOOK_SNAPSHOT_HPP
+
+#include "order_book.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace orderbook {
+
+// Binary snapshot of an OrderBook's complete resting state.
+//
+// Layout (host byte order; the magic reads back wrong on a foreign host)
+//     SnapshotHeader
+//     bid levels, best first, then ask levels, best first; each is
+//         SnapshotLevel
+//         SnapshotOrder x order_count, in FIFO (time priority) order
+// Levels carry prices rather than store keys, so a snapshot taken from one
+// PriceLevels policy restores into any other that can represent its prices.
+// The order-id index is not stored: restore assigns pool slots in file order
+// and indexes each order as it is placed.
+//
+// A MatchingEngine image (MatchingEngine::save_snapshot) is the book image
+// followed by the engine's own state (SnapshotEngineState and what follows
+// it); engines save, fork and restore only that form.
+constexpr uint32_t kSnapshotMagic = 0x5353424F; // "OBSS"
+constexpr uint16_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;    // sizeof(SnapshotHeader) of the writer
+    uint64_t journal_offset; // Journal position the snapshot reflects (see journal.hpp)
+    uint64_t l2_sequence;
+    uint64_t order_count;
+    uint32_t bid_levels;
+    uint32_t ask_levels;
+    uint64_t book_sequence;  // Last Order::sequence handed out (the order holding it may be gone)
+};
+
+struct SnapshotLevel {
+    double price;
+    uint32_t order_count;
+    uint32_t reserved;
+};
+
+struct SnapshotOrder {
+    uint64_t id;
+    uint32_t quantity; // Displayed
+    uint8_t flags;
+    uint8_t stp;       // SelfTradePolicy
+    uint8_t reserved[2];
+    int64_t timestamp; // steady_clock ticks
+    uint32_t reserve;  // Iceberg hidden quantity
+    uint32_t display;  // Iceberg slice size
+    uint64_t sequence; // Order::sequence
+    uint32_t account;
+    uint32_t reserved2;
+};
+
+// Engine section, after the book image
+//     SnapshotEngineState
+//     SnapshotStop x stop_count, in trigger order (FIFO per stop price)
+//     SnapshotAccount x account_count, accounts with any exposure or limit
+constexpr uint32_t kEngineStateMagic = 0x5345424F; // "OBES"
+
+struct SnapshotEngineState {
+    uint32_t magic;
+    uint8_t auction;        // In an auction call
+    uint8_t reserved[3];
+    double last_price;      // NaN before the first trade
+    uint64_t next_sequence; // apply_sequenced position
+    uint64_t rolling_hash;
+    uint64_t stop_sequence; // Last stop Order::sequence handed out
+    uint32_t stop_count;
+    uint32_t account_count;
+};
+
+struct SnapshotStop {
+    uint64_t id;
+    double price;
+    double stop_price;
+    int64_t timestamp; // steady_clock ticks
+    uint64_t sequence; // Order::sequence (stop book arrival order)
+    uint32_t quantity;
+    uint32_t display;
+    uint32_t account;
+    uint8_t type;      // OrderType
+    uint8_t side;      // Side
+    uint8_t tif;       // TimeInForce
+    uint8_t post_only;
+    uint8_t stp;       // SelfTradePolicy
+    uint8_t reserved[7];
+};
+
+struct SnapshotAccount {
+    uint32_t account;
+    uint32_t reserved;
+    int64_t position;
+    uint64_t bought;
+    uint64_t sold;
+    uint64_t position_limit;
+};
+
+static_assert(sizeof(SnapshotHeader) == 48, "snapshot layout changed: bump kSnapshotVersion");
+static_assert(sizeof(SnapshotLevel) == 16, "snapshot layout changed: bump kSnapshotVersion");
+static_assert(sizeof(SnapshotOrder) == 48, "snapshot layout changed: bump kSnapshotVersion");
+static_assert(sizeof(SnapshotEngineState) == 48, "snapshot layout changed: bump kSnapshotVersion");
+static_assert(sizeof(SnapshotStop) == 64, "snapshot layout changed: bump kSnapshotVersion");
+static_assert(sizeof(SnapshotAccount) == 40, "snapshot layout changed: bump kSnapshotVersion");
+
+// Serializer with access to OrderBook internals
+template <typename PriceLevels>
+struct BookSnapshot {
+    using Book = OrderBook<PriceLevels>;
+
+    // Stream the snapshot to write(const void* data, size_t size). Nothing
+    // is allocated, so this is safe in a forked child.
+    template <typename Write>
+    static void save(const Book& book, Write& write, uint64_t journal_offset) {
+        SnapshotHeader header{};
+        header.magic = kSnapshotMagic;
+        header.version = kSnapshotVersion;
+        header.header_size = sizeof(SnapshotHeader);
+        header.journal_offset = journal_offset;
+        header.l2_sequence = book.l2_sequence_;
+        header.order_count = book.bid_totals_.orders + book.ask_totals_.orders;
+        header.bid_levels = static_cast<uint32_t>(book.bids_.level_count());
+        header.ask_levels = static_cast<uint32_t>(book.asks_.level_count());
+        header.book_sequence = book.sequence_;
+        write(&header, sizeof(header));
+        save_side(book, book.bids_, write);
+        save_side(book, book.asks_, write);
+    }
+
+    // Load a snapshot into an empty book, placing orders straight into
+    // their levels. Returns the snapshot's journal offset, or nullopt if the
+    // book is not empty or the data is malformed. A book that fails part
+    // way (duplicate IDs, prices the store cannot hold) must be discarded.
+    static std::optional<uint64_t> load(Book& book, const uint8_t* data, size_t size) {
+        SnapshotHeader header;
+        if (book.bid_count() + book.ask_count() != 0 || image_size(data, size) != size) {
+            return std::nullopt;
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        const uint8_t* p = data + sizeof(header);
+        if (!load_side(book, book.bids_, Side::Buy, header.bid_levels, p) ||
+            !load_side(book, book.asks_, Side::Sell, header.ask_levels, p)) {
+            return std::nullopt;
+        }
+        book.l2_sequence_ = header.l2_sequence;
+        book.sequence_ = std::max(book.sequence_, header.book_sequence);
+        return header.journal_offset;
+    }
+
+    // Bytes of the book image at the start of data, or 0 if it is malformed
+    static size_t image_size(const uint8_t* data, size_t size) {
+        SnapshotHeader header;
+        if (size < sizeof(header)) return 0;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != kSnapshotMagic || header.version != kSnapshotVersion ||
+            header.header_size != sizeof(header)) {
+            return 0;
+        }
+        return well_formed(header, data, size);
+    }
+
+private:
+    template <typename Store, typename Write>
+    static void save_side(const Book& book, const Store& levels, Write& write) {
+        levels.for_each([&](auto key, const PriceLevel& level) {
+            SnapshotLevel record{levels.to_price(key), level.order_count, 0};
+            write(&record, sizeof(record));
+            for (uint32_t slot = level.head; slot != kNullSlot; slot = book.pool_[slot].next) {
+                const auto& resting = book.pool_[slot];
+                SnapshotOrder order{};
+                order.id = resting.id;
+                order.quantity = resting.quantity;
+                order.flags = resting.flags;
+                order.timestamp = book.pool_.meta(slot).timestamp.time_since_epoch().count();
+                order.reserve = book.pool_.meta(slot).reserve;
+                order.display = book.pool_.meta(slot).display;
+                order.sequence = book.pool_.meta(slot).sequence;
+                order.account = book.pool_.meta(slot).account;
+                order.stp = static_cast<uint8_t>(book.pool_.meta(slot).stp);
+                write(&order, sizeof(order));
+            }
+            return true;
+        });
+    }
+
+    // Check every level record and order run fits before touching the
+    // book. Returns where the image ends (0 if it does not fit).
+    static size_t well_formed(const SnapshotHeader& header, const uint8_t* data, size_t size) {
+        size_t pos = sizeof(header);
+        uint64_t orders = 0;
+        uint64_t levels = uint64_t(header.bid_levels) + header.ask_levels;
+        for (uint64_t i = 0; i < levels; i++) {
+            SnapshotLevel level;
+            if (size - pos < sizeof(level)) return 0;
+            std::memcpy(&level, data + pos, sizeof(level));
+            pos += sizeof(level);
+            if (level.order_count == 0 || (size - pos) / sizeof(SnapshotOrder) < level.order_count) {
+                return 0;
+            }
+            pos += size_t(level.order_count) * sizeof(SnapshotOrder);
+            orders += level.order_count;
+        }
+        return orders == header.order_count ? pos : 0;
+    }
+
+    template <typename Store>
+    static bool load_side(Book& book, Store& levels, Side side, uint32_t count, const uint8_t*& p) {
+        auto& totals = book.totals(side);
+        for (uint32_t i = 0; i < count; i++) {
+            SnapshotLevel record;
+            std::memcpy(&record, p, sizeof(record));
+            p += sizeof(record);
+            auto key = levels.to_key(record.price);
+            PriceLevel* level = key ? levels.emplace(*key) : nullptr;
+            if (!level || !level->empty()) {
+                return false; // Unrepresentable or repeated price
+            }
+            for (uint32_t k = 0; k < record.order_count; k++) {
+                SnapshotOrder order;
+                std::memcpy(&order, p, sizeof(order));
+                p += sizeof(order);
+                uint32_t slot = book.pool_.allocate();
+                if (order.account >= book.account_heads_.size() ||
+                    !book.order_index_.insert(order.id, slot)) {
+                    book.pool_.release(slot);
+                    return false; // Unknown account or duplicate ID
+                }
+                auto& resting = book.pool_[slot];
+                resting.id = order.id;
+                resting.price = *key;
+                resting.quantity = order.quantity;
+                resting.side = side;
+                resting.flags = order.flags;
+                book.pool_.meta(slot).timestamp = std::chrono::steady_clock::time_point(
+                    std::chrono::steady_clock::duration(order.timestamp));
+                book.pool_.meta(slot).reserve = order.reserve;
+                book.pool_.meta(slot).display = order.display;
+                book.pool_.meta(slot).sequence = order.sequence;
+                book.pool_.meta(slot).account = order.account;
+                book.pool_.meta(slot).stp = static_cast<SelfTradePolicy>(order.stp);
+                book.sequence_ = std::max(book.sequence_, order.sequence);
+                book.account_link(slot);
+                book.rehash(slot);
+                push_back(book.pool_, *level, slot);
+                level->order_count++;
+                level->total_quantity += order.quantity;
+                totals.orders++;
+                totals.quantity += order.quantity;
+            }
+        }
+        return true;
+    }
+};
+
+// Serialize book into out (appending)
+template <typename PriceLevels>
+void save_snapshot(const OrderBook<PriceLevels>& book, std::vector<uint8_t>& out,
+                   uint64_t journal_offset = 0) {
+    auto write = [&](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    };
+    BookSnapshot<PriceLevels>::save(book, write, journal_offset);
+}
+
+// Restore a snapshot into an empty book; returns its journal offset
+template <typename PriceLevels>
+std::optional<uint64_t> load_snapshot(OrderBook<PriceLevels>& book, const uint8_t* data, size_t size) {
+    return BookSnapshot<PriceLevels>::load(book, data, size);
+}
+
+// Length of the book image data starts with (0 if malformed), e.g. to find
+// the engine section after it
+template <typename PriceLevels>
+size_t snapshot_image_size(const uint8_t* data, size_t size) {
+    return BookSnapshot<PriceLevels>::image_size(data, size);
+}
+
+// Write an image to path through a fixed buffer (no allocation):
+// save(write) streams it, as BookSnapshot::save does. The file is written
+// beside path and renamed over it once complete.
+template <typename Save>
+bool write_image_file(const char* path, const char* tmp_path, Save&& save) {
+    int fd = ::open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    struct Writer {
+        int fd;
+        bool ok = true;
+        size_t used = 0;
+        uint8_t buffer[64 * 1024]; // Left uninitialized: written before read
+
+        explicit Writer(int descriptor) : fd(descriptor) {}
+
+        void operator()(const void* data, size_t size) {
+            if (used + size > sizeof(buffer)) flush();
+            std::memcpy(buffer + used, data, size);
+            used += size;
+        }
+        void flush() {
+            for (size_t done = 0; ok && done < used;) {
+                ssize_t n = ::write(fd, buffer + done, used - done);
+                if (n <= 0) ok = false; else done += static_cast<size_t>(n);
+            }
+            used = 0;
+        }
+    };
+    Writer writer(fd);
+    save(writer);
+    writer.flush();
+    bool ok = writer.ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    return ok && ::rename(tmp_path, path) == 0;
+}
+
+// Snapshot without stalling matching: a forked child streams its
+// copy-on-write image through save(write) while the caller carries on. The
+// child only runs the allocation-free writer and _exit()s. Returns the
+// child's pid for wait_snapshot(), or -1 if fork failed.
+template <typename Save>
+pid_t fork_image_file(const char* path, Save&& save) {
+    std::string tmp = std::string(path) + ".tmp"; // Built before fork
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        bool ok = write_image_file(path, tmp.c_str(), save);
+        ::_exit(ok ? 0 : 1);
+    }
+    return pid;
+}
+
+// Reap a fork_snapshot() child; true if it wrote the snapshot
+inline bool wait_snapshot(pid_t pid) {
+    int status = 0;
+    if (pid <= 0 || ::waitpid(pid, &status, 0) != pid) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Read a whole snapshot file with one bulk read
+inline bool read_image_file(const char* path, std::vector<uint8_t>& data) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0;
+    if (ok) {
+        data.resize(static_cast<size_t>(st.st_size));
+        for (size_t done = 0; ok && done < data.size();) {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n <= 0) ok = false; else done += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+// Book-only snapshot files (MatchingEngine has its own, with the engine
+// section)
+template <typename PriceLevels>
+bool write_snapshot_file(const OrderBook<PriceLevels>& book, const char* path,
+                         uint64_t journal_offset = 0) {
+    std::string tmp = std::string(path) + ".tmp";
+    return write_image_file(path, tmp.c_str(), [&](auto& write) {
+        BookSnapshot<PriceLevels>::save(book, write, journal_offset);
+    });
+}
+
+template <typename PriceLevels>
+pid_t fork_snapshot(const OrderBook<PriceLevels>& book, const char* path,
+                    uint64_t journal_offset = 0) {
+    return fork_image_file(path, [&](auto& write) {
+        BookSnapshot<PriceLevels>::save(book, write, journal_offset);
+    });
+}
+
+template <typename PriceLevels>
+std::optional<uint64_t> load_snapshot_file(OrderBook<PriceLevels>& book, const char* path) {
+    std::vector<uint8_t> data;
+    if (!read_image_file(path, data)) return std::nullopt;
+    return load_snapshot(book, data.data(), data.size());
+}
+
+} // namespace orderbook
+
+#endif // BOOK_SNAPSHOT_HPP
@@ -0,0 +1,26 @@
+#ifndef COMMAND_HPP
+#define COMMAND_HPP
+
+#include "order.hpp"
+#include <cstdint>
+
+namespace orderbook {
+
+enum class CommandType : uint8_t {
+    NewOrder, // Match / rest order
+    Cancel,   // Cancel order.id
+    Replace   // Give order.id the new order.price / order.quantity
+};
+
+// Fixed-size inbound message for one instrument, as passed between threads
+// and applied with MatchingEngine::apply()
+struct Command {
+    CommandType type;
+    uint32_t symbol;
+    Order order;
+    uint64_t sequence = 0; // Sequencer's number, for MatchingEngine::apply_sequenced (from 1)
+};
+
+} // namespace orderbook
+
+#endif // COMMAND_HPP
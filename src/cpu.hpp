@@ -0,0 +1,45 @@
+#ifndef CPU_HPP
+#define CPU_HPP
+
+#include <cstddef>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace orderbook {
+
+constexpr size_t kCacheLine = 64;
+
+// Spin-wait hint for busy-polling loops
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Pin the calling thread to one CPU (wrapped modulo the CPU count)
+inline void pin_to_cpu(unsigned cpu) {
+#if defined(__linux__)
+    unsigned ncpu = std::thread::hardware_concurrency();
+    if (ncpu == 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % ncpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu; // No portable affinity API (e.g. macOS): left to the scheduler
+#endif
+}
+
+} // namespace orderbook
+
+#endif // CPU_HPP
@@ -0,0 +1,174 @@
+#ifndef ENGINE_PIPELINE_HPP
+#define ENGINE_PIPELINE_HPP
+
+#include "matching_engine.hpp"
+#include "command.hpp"
+#include "spsc_ring.hpp"
+#include "mpsc_ring.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace orderbook {
+
+enum class EgressType : uint8_t {
+    Trade,           // trade is valid
+    OrderAck,        // order_id (a new order) ended as status with leaves resting (after its trades)
+    CancelAccepted,  // order_id was cancelled
+    CancelRejected,  // order_id was not resting
+    ReplaceAccepted, // order_id took its new terms as status with leaves (trades precede this)
+    ReplaceRejected  // order_id was not resting, or the new price is unusable
+};
+
+// Fixed-size result message published by the matching thread; every
+// command gets exactly one non-Trade event
+struct EgressEvent {
+    EgressType type;
+    uint64_t order_id;
+    Trade trade;
+    OrderStatus status = OrderStatus::Rejected; // OrderAck, ReplaceAccepted
+    uint32_t leaves = 0;                        // OrderAck, ReplaceAccepted: quantity left resting
+};
+
+// Gateway -> matching thread -> publisher pipeline around one MatchingEngine.
+//
+// Ingress: one SPSC ring per gateway thread (gateway(i)), plus a shared MPSC
+// ring (shared()) for producers that cannot own a ring. A dedicated
+// busy-polling matching thread drains them round-robin in batches of up to
+// kBatch commands and applies them to the engine, which it alone touches, so
+// the single-writer hot path is unchanged. Results leave through one SPSC
+// egress ring read with poll(); if it fills, the matching thread waits for
+// the consumer rather than dropping events.
+template <typename PriceLevels = MapPriceLevels>
+class EnginePipeline {
+public:
+    static constexpr size_t kIngressSize = 4096;
+    static constexpr size_t kEgressSize = 16384;
+    static constexpr size_t kBatch = 64;
+
+    using GatewayRing = SpscRing<Command, kIngressSize>;
+    using SharedRing = MpscRing<Command, kIngressSize>;
+
+    // cpu < 0 leaves the matching thread unpinned
+    explicit EnginePipeline(size_t num_gateways, const BookConfig& config = {}, int cpu = -1)
+        : engine_(config) {
+        for (size_t i = 0; i < num_gateways; i++) {
+            gateways_.push_back(std::make_unique<GatewayRing>());
+        }
+        thread_ = std::thread([this, cpu] {
+            if (cpu >= 0) {
+                pin_to_cpu(static_cast<unsigned>(cpu));
+            }
+            run();
+        });
+    }
+
+    ~EnginePipeline() { stop(); }
+
+    EnginePipeline(const EnginePipeline&) = delete;
+    EnginePipeline& operator=(const EnginePipeline&) = delete;
+
+    // Ring owned by gateway thread i (exactly one producer per ring)
+    GatewayRing& gateway(size_t i) { return *gateways_[i]; }
+
+    // Ring any thread may push to
+    SharedRing& shared() { return shared_; }
+
+    // Consumer side of the egress ring (one thread)
+    bool poll(EgressEvent& out) { return egress_.try_pop(out); }
+
+    // Process everything already queued, then join the matching thread.
+    // Producers must have stopped pushing. Idempotent.
+    void stop() {
+        running_.store(false, std::memory_order_release);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Commands applied so far (relaxed, readable from any thread)
+    uint64_t processed() const { return processed_.load(std::memory_order_relaxed); }
+
+    // Engine access for inspection; only valid after stop()
+    const MatchingEngine<PriceLevels>& engine() const { return engine_; }
+
+private:
+    MatchingEngine<PriceLevels> engine_;
+    std::vector<std::unique_ptr<GatewayRing>> gateways_;
+    SharedRing shared_;
+    SpscRing<EgressEvent, kEgressSize> egress_;
+    alignas(kCacheLine) std::atomic<bool> running_{true};
+    alignas(kCacheLine) std::atomic<uint64_t> processed_{0};
+    std::thread thread_;
+
+    void run() {
+        Command batch[kBatch];
+        uint64_t processed = 0;
+        for (;;) {
+            // Read the flag before draining so nothing pushed before stop()
+            // can be missed on the final pass
+            bool running = running_.load(std::memory_order_acquire);
+            size_t drained = 0;
+            for (auto& ring : gateways_) {
+                drained += apply_batch(batch, ring->pop_batch(batch, kBatch));
+            }
+            drained += apply_batch(batch, shared_.pop_batch(batch, kBatch));
+
+            if (drained == 0) {
+                if (!running) break;
+                cpu_relax();
+                continue;
+            }
+            processed += drained;
+            processed_.store(processed, std::memory_order_relaxed);
+        }
+    }
+
+    size_t apply_batch(const Command* batch, size_t n) {
+        auto trades = [this](const Trade& trade) { publish({EgressType::Trade, 0, trade}); };
+        for (size_t i = 0; i < n; i++) {
+            const Order& order = batch[i].order;
+            switch (batch[i].type) {
+            case CommandType::NewOrder:
+                acknowledge(EgressType::OrderAck, order.id, engine_.process_order(order, trades));
+                break;
+            case CommandType::Cancel:
+                publish({engine_.cancel_order(order.id) ? EgressType::CancelAccepted : EgressType::CancelRejected,
+                         order.id, Trade{}});
+                break;
+            case CommandType::Replace: {
+                OrderStatus status = engine_.replace_order(order.id, order.price, order.quantity, trades);
+                if (status == OrderStatus::Rejected) {
+                    publish({EgressType::ReplaceRejected, order.id, Trade{}});
+                } else {
+                    acknowledge(EgressType::ReplaceAccepted, order.id, status);
+                }
+                break;
+            }
+            }
+        }
+        return n;
+    }
+
+    // Leaves are read back from the book, so a stop triggered by the order
+    // that then traded with it is accounted for
+    void acknowledge(EgressType type, uint64_t order_id, OrderStatus status) {
+        uint32_t leaves = 0;
+        if (status == OrderStatus::Resting) {
+            auto resting = engine_.book().find_order(order_id);
+            leaves = resting ? resting->quantity : 0;
+        }
+        publish({type, order_id, Trade{}, status, leaves});
+    }
+
+    void publish(const EgressEvent& event) {
+        while (!egress_.try_push(event)) {
+            cpu_relax();
+        }
+    }
+};
+
+} // namespace orderbook
+
+#endif // ENGINE_PIPELINE_HPP
@@ -0,0 +1,226 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include "cpu.hpp"
+#include "order.hpp"
+#include "tsc.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace orderbook {
+
+// Hot-path instrumentation: TSC cycle counts per matching stage and per
+// message kind, compiled in only with -DORDERBOOK_INSTRUMENT. Without it
+// the probe macros expand to nothing, so the engine is unchanged.
+//
+// Each thread that runs a probe gets its own HotPathStats (cache-line
+// aligned, one line of counters per histogram) and is its only writer:
+// updates are relaxed load + store, no locked instructions. Any other
+// thread may read them at any time with relaxed loads; a reading can be a
+// few events behind or mix fields from adjacent events, never torn values.
+//
+// Stages nest: BookInsert includes the level lookup and index update it
+// does, and each message covers every stage it went through.
+#if defined(ORDERBOOK_INSTRUMENT)
+constexpr bool kInstrumented = true;
+#else
+constexpr bool kInstrumented = false;
+#endif
+
+enum class Stage : uint8_t {
+    Dispatch,    // Entry: the steady_clock stamp on an incoming order
+    LevelLookup, // Price -> key conversion, best/level find or emplace
+    FillLoop,    // Matching against the opposite side
+    BookInsert,  // Resting an order (or run) at its level
+    IndexUpdate, // Order-ID index insert / erase
+    kCount
+};
+
+enum class MessageKind : uint8_t {
+    Market,
+    Limit,
+    Stop, // Stop and stop-limit on entry
+    Cancel,
+    Replace,
+    kCount
+};
+
+inline MessageKind message_kind(OrderType type) {
+    switch (type) {
+    case OrderType::Market: return MessageKind::Market;
+    case OrderType::Limit: return MessageKind::Limit;
+    default: return MessageKind::Stop;
+    }
+}
+
+// Plain copy of one histogram, as read by an observer
+struct CycleSnapshot {
+    static constexpr size_t kBuckets = 64;
+
+    uint64_t count = 0;
+    uint64_t cycles = 0;
+    uint64_t max = 0;
+    std::array<uint64_t, kBuckets> buckets{}; // Bucket b: [2^(b-1), 2^b) cycles, b = 0 for 0
+
+    double mean() const { return count ? static_cast<double>(cycles) / static_cast<double>(count) : 0.0; }
+
+    // Upper bound (in cycles) of the bucket holding fraction p of events
+    uint64_t percentile(double p) const {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+        if (rank >= count) return max;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kBuckets; b++) {
+            seen += buckets[b];
+            if (seen > rank) {
+                uint64_t bound = b == 0 ? 0 : (uint64_t(1) << b) - 1;
+                return bound < max ? bound : max;
+            }
+        }
+        return max;
+    }
+
+    void merge(const CycleSnapshot& other) {
+        count += other.count;
+        cycles += other.cycles;
+        max = max > other.max ? max : other.max;
+        for (size_t b = 0; b < kBuckets; b++) buckets[b] += other.buckets[b];
+    }
+};
+
+// Power-of-two histogram of cycle counts with one writer thread
+class alignas(kCacheLine) CycleHistogram {
+public:
+    void record(uint64_t cycles) {
+        bump(count_, 1);
+        bump(cycles_, cycles);
+        if (cycles > max_.load(std::memory_order_relaxed)) {
+            max_.store(cycles, std::memory_order_relaxed);
+        }
+        size_t b = cycles == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(cycles));
+        bump(buckets_[b < CycleSnapshot::kBuckets ? b : CycleSnapshot::kBuckets - 1], 1);
+    }
+
+    CycleSnapshot read() const {
+        CycleSnapshot s;
+        s.count = count_.load(std::memory_order_relaxed);
+        s.cycles = cycles_.load(std::memory_order_relaxed);
+        s.max = max_.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < CycleSnapshot::kBuckets; b++) {
+            s.buckets[b] = buckets_[b].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    // Hot counters share the first line; the buckets follow
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> cycles_{0};
+    std::atomic<uint64_t> max_{0};
+    std::array<std::atomic<uint64_t>, CycleSnapshot::kBuckets> buckets_{};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+};
+
+// One thread's counters
+struct alignas(kCacheLine) HotPathStats {
+    std::array<CycleHistogram, static_cast<size_t>(Stage::kCount)> stages;
+    std::array<CycleHistogram, static_cast<size_t>(MessageKind::kCount)> messages;
+
+    CycleHistogram& stage(Stage s) { return stages[static_cast<size_t>(s)]; }
+    CycleHistogram& message(MessageKind k) { return messages[static_cast<size_t>(k)]; }
+};
+
+namespace detail {
+
+// Every thread's stats, kept for the life of the process so a reader never
+// sees one freed under it (threads are few; a block is a few KB)
+struct StatsRegistry {
+    std::mutex mutex;
+    std::vector<HotPathStats*> threads;
+
+    static StatsRegistry& instance() {
+        static StatsRegistry registry;
+        return registry;
+    }
+};
+
+} // namespace detail
+
+// The calling thread's stats, registered on first use (off the hot path
+// after that: one thread-local load)
+inline HotPathStats& hot_path_stats() {
+    thread_local HotPathStats* stats = [] {
+        auto* s = new HotPathStats();
+        auto& registry = detail::StatsRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(s);
+        return s;
+    }();
+    return *stats;
+}
+
+// Observer side: f(const HotPathStats&) for each registered thread
+template <typename F>
+void for_each_hot_path_stats(F&& f) {
+    auto& registry = detail::StatsRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex); // Registration only: writers never take it
+    for (const HotPathStats* s : registry.threads) {
+        f(*s);
+    }
+}
+
+// Observer side: one stage or message kind summed over all threads
+inline CycleSnapshot read_stage(Stage stage) {
+    CycleSnapshot total;
+    for_each_hot_path_stats([&](const HotPathStats& s) {
+        total.merge(s.stages[static_cast<size_t>(stage)].read());
+    });
+    return total;
+}
+
+inline CycleSnapshot read_message(MessageKind kind) {
+    CycleSnapshot total;
+    for_each_hot_path_stats([&](const HotPathStats& s) {
+        total.merge(s.messages[static_cast<size_t>(kind)].read());
+    });
+    return total;
+}
+
+// Records the cycles from construction to destruction into one histogram
+class ProbeScope {
+public:
+    explicit ProbeScope(CycleHistogram& histogram) : histogram_(histogram), start_(tsc_now()) {}
+    ~ProbeScope() { histogram_.record(tsc_now() - start_); }
+    ProbeScope(const ProbeScope&) = delete;
+    ProbeScope& operator=(const ProbeScope&) = delete;
+
+private:
+    CycleHistogram& histogram_;
+    uint64_t start_;
+};
+
+} // namespace orderbook
+
+#define ORDERBOOK_PROBE_CONCAT_(a, b) a##b
+#define ORDERBOOK_PROBE_NAME_(line) ORDERBOOK_PROBE_CONCAT_(orderbook_probe_, line)
+
+// ORDERBOOK_PROBE(Stage::X) / ORDERBOOK_PROBE_MESSAGE(kind): time the rest
+// of the enclosing scope
+#if defined(ORDERBOOK_INSTRUMENT)
+#define ORDERBOOK_PROBE(which) \
+    ::orderbook::ProbeScope ORDERBOOK_PROBE_NAME_(__LINE__)(::orderbook::hot_path_stats().stage(which))
+#define ORDERBOOK_PROBE_MESSAGE(which) \
+    ::orderbook::ProbeScope ORDERBOOK_PROBE_NAME_(__LINE__)(::orderbook::hot_path_stats().message(which))
+#else
+#define ORDERBOOK_PROBE(which) static_cast<void>(0)
+#define ORDERBOOK_PROBE_MESSAGE(which) static_cast<void>(0)
+#endif
+
+#endif // INSTRUMENTATION_HPP
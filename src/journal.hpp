@@ -0,0 +1,249 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "binary_protocol.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace orderbook {
+
+// Append-only journal of inbound wire messages (see binary_protocol.hpp)
+// kept in a memory-mapped file.
+//
+// File layout
+//     u64 magic
+//     u64 committed   record bytes that follow the header, as of the last flush
+//     ...             padding up to kJournalHeaderSize
+//     records         framed wire messages, back to back
+// The file is reserved and pre-faulted once when it is opened, so appending
+// is a memcpy into mapped memory and never a write() call. Replay maps the
+// file and hands the records straight to wire::decode().
+constexpr uint64_t kJournalMagic = 0x314C4E524A424FULL; // "OBJRNL1"
+constexpr size_t kJournalHeaderSize = 64;
+
+// When flush() forces appended records to storage
+enum class FsyncPolicy : uint8_t {
+    None,  // Never; the kernel writes back in its own time (survives a process crash)
+    Async, // Start write-back of the flushed range (msync MS_ASYNC)
+    Sync   // Wait until the flushed range is on storage (msync MS_SYNC)
+};
+
+struct JournalConfig {
+    size_t capacity = size_t(1) << 28; // Record bytes reserved and pre-faulted up front
+    size_t flush_bytes = 64 * 1024;    // Appended bytes between automatic flushes
+    FsyncPolicy fsync = FsyncPolicy::Async;
+};
+
+class JournalWriter {
+public:
+    // Open path for appending, creating it if needed. An existing journal
+    // is resumed after its last record and kept at least its current size.
+    explicit JournalWriter(const char* path, const JournalConfig& config = {})
+        : config_(config) {
+        if (!open(path)) close_file();
+    }
+
+    ~JournalWriter() {
+        flush();
+        close_file();
+    }
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    bool is_open() const { return base_ != nullptr; }
+
+    // Append complete framed messages. Returns false, appending nothing, if
+    // they do not fit. Flushes once flush_bytes have built up; until then
+    // the records are past the header's committed size, so a reader or a
+    // recovery never sees them.
+    bool append(const uint8_t* data, size_t size) {
+        if (!is_open() || size > capacity() - size_) {
+            return false;
+        }
+        std::memcpy(base_ + kJournalHeaderSize + size_, data, size);
+        size_ += size;
+        if (size_ - synced_ >= config_.flush_bytes) {
+            flush();
+        }
+        return true;
+    }
+
+    // Commit records appended since the last flush: force them out as the
+    // fsync policy says, and only once that returns write the header size
+    // that covers them (and force it out too). With Sync the header can
+    // never reach storage ahead of its records; Async only starts both
+    // write-backs in that order.
+    bool flush() {
+        if (!is_open() || size_ == synced_) return true;
+        int mode = config_.fsync == FsyncPolicy::Sync ? MS_SYNC : MS_ASYNC;
+        if (config_.fsync != FsyncPolicy::None) {
+            size_t begin = (kJournalHeaderSize + synced_) & ~(page_size() - 1);
+            size_t end = kJournalHeaderSize + size_;
+            if (::msync(base_ + begin, end - begin, mode) != 0) {
+                return false; // Uncommitted; the next flush retries
+            }
+        }
+        wire::store_le<uint64_t>(base_ + 8, size_);
+        synced_ = size_;
+        return config_.fsync == FsyncPolicy::None || ::msync(base_, kJournalHeaderSize, mode) == 0;
+    }
+
+    size_t size() const { return size_; }         // Record bytes appended
+    size_t committed() const { return synced_; }  // Of those, covered by the header
+    size_t capacity() const { return length_ - kJournalHeaderSize; }
+
+private:
+    JournalConfig config_;
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t length_ = 0;
+    size_t size_ = 0;   // Record bytes appended
+    size_t synced_ = 0; // Record bytes covered by the header (the rest is the unflushed tail)
+
+    bool open(const char* path) {
+        fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) return false;
+
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) return false;
+        size_t existing = static_cast<size_t>(st.st_size);
+        size_t length = kJournalHeaderSize + config_.capacity;
+        if (existing > length) length = existing;
+        if (existing >= kJournalHeaderSize) {
+            uint8_t header[16];
+            if (::pread(fd_, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+                wire::load_le<uint64_t>(header) != kJournalMagic) {
+                return false; // Not a journal: leave the file alone
+            }
+        }
+
+        // Reserve blocks now so a full disk fails here, not as SIGBUS later
+#if defined(__linux__)
+        if (::posix_fallocate(fd_, 0, static_cast<off_t>(length)) != 0) return false;
+#else
+        if (::ftruncate(fd_, static_cast<off_t>(length)) != 0) return false;
+#endif
+        int flags = MAP_SHARED;
+#if defined(__linux__)
+        flags |= MAP_POPULATE;
+#endif
+        void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, fd_, 0);
+        if (base == MAP_FAILED) return false;
+        base_ = static_cast<uint8_t*>(base);
+        length_ = length;
+
+        if (existing >= kJournalHeaderSize) {
+            size_ = wire::load_le<uint64_t>(base_ + 8);
+            if (size_ > capacity()) return false;
+        } else {
+            wire::store_le<uint64_t>(base_, kJournalMagic);
+            wire::store_le<uint64_t>(base_ + 8, 0);
+        }
+        synced_ = size_;
+
+        // Touch every page so appends never take a page fault
+        volatile uint8_t* touch = base_;
+        for (size_t offset = 0; offset < length_; offset += page_size()) {
+            touch[offset] = touch[offset];
+        }
+        return true;
+    }
+
+    static size_t page_size() { return static_cast<size_t>(::sysconf(_SC_PAGESIZE)); }
+
+    void close_file() {
+        if (base_) ::munmap(base_, length_);
+        if (fd_ >= 0) ::close(fd_);
+        base_ = nullptr;
+        length_ = 0;
+        fd_ = -1;
+    }
+};
+
+// Read-only mapping of a journal for replay
+class MappedJournal {
+public:
+    explicit MappedJournal(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= kJournalHeaderSize) {
+            length_ = static_cast<size_t>(st.st_size);
+            int flags = MAP_PRIVATE;
+#if defined(__linux__)
+            flags |= MAP_POPULATE;
+#endif
+            void* base = ::mmap(nullptr, length_, PROT_READ, flags, fd, 0);
+            if (base != MAP_FAILED) {
+                base_ = static_cast<const uint8_t*>(base);
+                ::madvise(const_cast<uint8_t*>(base_), length_, MADV_SEQUENTIAL);
+                uint64_t committed = wire::load_le<uint64_t>(base_ + 8);
+                if (wire::load_le<uint64_t>(base_) != kJournalMagic ||
+                    committed > length_ - kJournalHeaderSize) {
+                    unmap();
+                } else {
+                    size_ = committed;
+                }
+            }
+        }
+        ::close(fd); // The mapping stays valid without the descriptor
+    }
+
+    ~MappedJournal() { unmap(); }
+
+    MappedJournal(const MappedJournal&) = delete;
+    MappedJournal& operator=(const MappedJournal&) = delete;
+
+    bool is_open() const { return base_ != nullptr; }
+    const uint8_t* data() const { return base_ + kJournalHeaderSize; }
+    size_t size() const { return size_; } // Record bytes
+
+    // Apply every record from byte offset from (0, or an offset returned
+    // by an earlier replay) to engine. Returns the offset replay stopped at.
+    template <typename Engine, typename Handler>
+    size_t replay(Engine& engine, Handler& handler, size_t from = 0) const {
+        if (!is_open() || from >= size_) return from;
+        return from + wire::decode(data() + from, size_ - from, engine, handler);
+    }
+
+    template <typename Engine>
+    size_t replay(Engine& engine, size_t from = 0) const {
+        wire::NullHandler handler;
+        return replay(engine, handler, from);
+    }
+
+private:
+    const uint8_t* base_ = nullptr;
+    size_t length_ = 0;
+    size_t size_ = 0;
+
+    void unmap() {
+        if (base_) ::munmap(const_cast<uint8_t*>(base_), length_);
+        base_ = nullptr;
+        size_ = 0;
+    }
+};
+
+// Write-ahead entry point: journal the complete messages in
+// [data, data + size), then decode them into engine. Returns the bytes
+// consumed, or 0 if the journal is full (nothing is applied).
+template <typename Engine, typename Handler>
+size_t journal_and_decode(JournalWriter& journal, const uint8_t* data, size_t size,
+                          Engine& engine, Handler& handler) {
+    size_t complete = wire::complete_size(data, size);
+    if (complete == 0 || !journal.append(data, complete)) {
+        return 0;
+    }
+    return wire::decode(data, complete, engine, handler);
+}
+
+} // namespace orderbook
+
+#endif // JOURNAL_HPP
@@ -0,0 +1,105 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+
+namespace orderbook {
+
+// HDR-style log-linear histogram of non-negative integer values (e.g. ns).
+//
+// Values below 2^kSubBits are counted exactly; above that, each power of
+// two is split into 2^(kSubBits - 1) equal buckets, so any recorded value
+// is reported within 1 / 2^(kSubBits - 1) (~0.8% at 8 bits) of itself, up
+// to 2^64. Recording is an index computation and one increment into a
+// table allocated once, so it can sit inside a measured loop.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBits = 8;
+    static constexpr uint64_t kSubCount = uint64_t(1) << kSubBits; // Exact range
+    static constexpr uint64_t kHalf = kSubCount / 2;                // Buckets per octave
+
+    LatencyHistogram() : counts_(kSubCount + (64 - kSubBits) * kHalf, 0) {}
+
+    void record(uint64_t value) {
+        counts_[index(value)]++;
+        count_++;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); i++) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    // Smallest recorded value v (to bucket precision) such that a fraction
+    // p of all values are <= v; p = 1 gives the exact max
+    uint64_t percentile(double p) const {
+        if (count_ == 0) return 0;
+        if (p >= 1.0) return max_;
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count_));
+        if (rank >= count_) rank = count_ - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return std::min(upper_bound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0; }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+
+    static size_t index(uint64_t value) {
+        if (value < kSubCount) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value)); // >= kSubBits
+        unsigned shift = msb - (kSubBits - 1);
+        uint64_t sub = (value >> shift) - kHalf; // Top bits below the leading one
+        return static_cast<size_t>(kSubCount + (msb - kSubBits) * kHalf + sub);
+    }
+
+    // Largest value that maps to bucket i
+    static uint64_t upper_bound(size_t i) {
+        if (i < kSubCount) {
+            return i;
+        }
+        uint64_t octave = (i - kSubCount) / kHalf;
+        uint64_t sub = (i - kSubCount) % kHalf;
+        unsigned shift = static_cast<unsigned>(octave + 1);
+        return ((kHalf + sub + 1) << shift) - 1;
+    }
+};
+
+} // namespace orderbook
+
+#endif // LATENCY_HISTOGRAM_HPP
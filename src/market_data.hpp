@@ -0,0 +1,41 @@
+#ifndef MARKET_DATA_HPP
+#define MARKET_DATA_HPP
+
+#include "order.hpp"
+#include <cstdint>
+
+namespace orderbook {
+
+// L2 (price-level) market data.
+//
+// With BookConfig::publish_l2 set, OrderBook records one L2Delta per level
+// change as a byproduct of add/cancel/modify/fill. Deltas carry the level's
+// state *after* the change and a book-wide sequence number, so a consumer can
+// apply them in order on top of a snapshot with an older sequence. Fills
+// against one level within a single match are coalesced into one delta.
+
+enum class LevelAction : uint8_t {
+    New,    // Level created
+    Change, // Quantity and/or order count changed
+    Delete  // Level emptied and removed
+};
+
+struct L2Delta {
+    uint64_t sequence;
+    Side side;
+    LevelAction action;
+    double price;
+    uint64_t quantity;    // Total resting quantity after the change
+    uint32_t order_count; // Resting orders after the change
+};
+
+// One level of a top-N snapshot
+struct L2Level {
+    double price;
+    uint64_t quantity;
+    uint32_t order_count;
+};
+
+} // namespace orderbook
+
+#endif // MARKET_DATA_HPP
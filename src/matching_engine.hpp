@@ -2,132 +2,762 @@
 #define MATCHING_ENGINE_HPP
 
 #include "order_book.hpp"
+#include "trade_sink.hpp"
+#include "command.hpp"
+#include "book_snapshot.hpp"
+#include "stop_book.hpp"
+#include "engine_clock.hpp"
+#include "account_risk.hpp"
+#include "auction.hpp"
+#include "arena.hpp"
+#include "state_hash.hpp"
+#include <memory>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace orderbook {
 
-// Represents a completed trade
-struct Trade {
-    uint64_t buy_order_id;
-    uint64_t sell_order_id;
-    double price;
-    uint32_t quantity;
-};
-
+// PriceLevels is forwarded to OrderBook to choose the price-level store;
+// Clock picks where order timestamps come from (see engine_clock.hpp).
+// With BookConfig::arena_bytes set, the engine owns an Arena (arena.hpp)
+// that every container of its book, stop book and risk table draws from;
+// otherwise they use BookConfig::arena if given, else the global heap.
+template <typename PriceLevels = MapPriceLevels, typename Clock = SteadyClock>
 class MatchingEngine {
 public:
+    MatchingEngine() : MatchingEngine(BookConfig{}) {}
+    explicit MatchingEngine(const BookConfig& config, Clock clock = Clock())
+        : arena_(config.arena_bytes > 0 ? std::make_unique<Arena>(config.arena_bytes, config.huge_pages)
+                                         : nullptr),
+          shared_arena_(config.arena), book_(with_arena(config)), clock_(clock),
+          risk_(config.max_accounts, arena()), curves_(arena()), stops_(64, arena()),
+          max_stop_triggers_(config.max_stop_triggers) {}
+
+    // Process an incoming order
+    // Each trade is passed to sink(const Trade&) as it occurs (see
+    // trade_sink.hpp); nothing is allocated on this path
+    template <typename Sink>
+    OrderStatus process_order(Order order, Sink&& sink) {
+        ORDERBOOK_PROBE_MESSAGE(message_kind(order.type));
+        stamp(order);
+        return dispatch(order, sink);
+    }
+
+    // Process a batch of orders in arrival order, as if by process_order()
+    // on each, with one clock read for the whole batch (a run of orders
+    // shares the stamp of its first).
+    // Upcoming orders' index entries and levels are prefetched a few
+    // messages ahead, and consecutive non-crossing limit orders at the same
+    // side and price rest in one step (they are adjacent in time, so doing
+    // so keeps price-time priority). No run forms while triggered stops are
+    // held back, since each order would release some first.
+    template <typename Sink>
+    void process_batch(const Order* orders, size_t count, Sink&& sink) {
+        constexpr size_t kPrefetchDistance = 4;
+        EngineTime now = clock_.now();
+
+        for (size_t i = 0; i < count && i < kPrefetchDistance; i++) {
+            book_.prefetch(orders[i]);
+        }
+        size_t i = 0;
+        while (i < count) {
+            const Order& first = orders[i];
+            size_t run = 1;
+            if (restable(first) && !stops_triggered() && !pending_stop(first.id)) {
+                auto key = book_.to_key(first.price);
+                if (key && !book_.crosses(first.side, *key)) {
+                    while (i + run < count && same_level(orders[i + run], first) &&
+                           !pending_stop(orders[i + run].id)) {
+                        run++;
+                    }
+                }
+            }
+            for (size_t k = i; k < i + run && k + kPrefetchDistance < count; k++) {
+                book_.prefetch(orders[k + kPrefetchDistance]);
+            }
+
+            if (run > 1) {
+                book_.add_run(orders + i, run, clock_.stamp(first, now));
+            } else {
+                ORDERBOOK_PROBE_MESSAGE(message_kind(first.type));
+                Order order = first;
+                order.timestamp = clock_.stamp(order, now);
+                dispatch(order, sink);
+            }
+            i += run;
+        }
+    }
+
     // Process an incoming order
     // Returns a vector of trades that occurred
     std::vector<Trade> process_order(Order order) {
         std::vector<Trade> trades;
-        order.timestamp = std::chrono::steady_clock::now();
+        process_order(order, [&](const Trade& trade) { trades.push_back(trade); });
+        return trades;
+    }
 
-        if (order.type == OrderType::Market) {
-            trades = match_market_order(order);
-        } else if (order.type == OrderType::Limit) {
-            trades = match_limit_order(order);
+    // Cancel an existing order (resting, or a stop not yet triggered)
+    bool cancel_order(uint64_t order_id) {
+        ORDERBOOK_PROBE_MESSAGE(MessageKind::Cancel);
+        return book_.cancel_order(order_id) || stops_.cancel(order_id);
+    }
+
+    // Cancel every resting order and pending stop matching filter in one
+    // operation (see OrderBook::mass_cancel; a stop is matched on its stop
+    // price), passing each to on_cancel(const Order&). Returns the count.
+    template <typename F>
+    size_t mass_cancel(const MassCancelFilter& filter, F&& on_cancel) {
+        ORDERBOOK_PROBE_MESSAGE(MessageKind::Cancel);
+        size_t cancelled = book_.mass_cancel(filter, on_cancel);
+        return cancelled + stops_.cancel_if([&](const Order& stop) {
+            return (filter.account == 0 || stop.account == filter.account) &&
+                   (!filter.side || *filter.side == stop.side) &&
+                   stop.stop_price >= filter.min_price && stop.stop_price <= filter.max_price;
+        }, on_cancel);
+    }
+
+    size_t mass_cancel(const MassCancelFilter& filter) {
+        return mass_cancel(filter, [](const Order&) {});
+    }
+
+    // Release stops already triggered but held back by the per-call bound
+    // (BookConfig::max_stop_triggers); trades go to sink. Returns true if
+    // triggered stops are still waiting.
+    template <typename Sink>
+    bool process_stops(Sink&& sink) {
+        run_triggers(clock_.now(), sink);
+        return stops_triggered();
+    }
+
+    bool stops_triggered() const { return stops_.triggered(last_price_); }
+    size_t pending_stops() const { return stops_.size(); }
+
+    // Price of the most recent trade (nullopt before the first)
+    std::optional<double> last_trade_price() const {
+        if (std::isnan(last_price_)) return std::nullopt;
+        return last_price_;
+    }
+
+    // Give resting order order_id a new price and quantity as one
+    // operation: one index lookup, and the node is moved rather than freed
+    // and reallocated. Less quantity at the same price keeps queue position;
+    // otherwise the order goes to the back of its new level, first trading
+    // (as the aggressor, trades to sink) if the new price crosses.
+    // Quantity 0 cancels. Returns Rejected, leaving the order as it was, if
+    // order_id is unknown, new_price cannot be stored, or the order is
+    // post-only and new_price would cross.
+    template <typename Sink>
+    OrderStatus replace_order(uint64_t order_id, double new_price, uint32_t new_quantity, Sink&& sink) {
+        ORDERBOOK_PROBE_MESSAGE(MessageKind::Replace);
+        EngineTime now = clock_.now();
+        OrderStatus status = replace(order_id, new_price, new_quantity, now, sink);
+        run_triggers(now, sink);
+        return status;
+    }
+
+    // Apply an inbound command, passing any trades to sink
+    // Returns false if a cancel or replace named an unknown order (or a
+    // replace was rejected)
+    template <typename Sink>
+    bool apply(const Command& command, Sink&& sink) {
+        switch (command.type) {
+        case CommandType::NewOrder:
+            process_order(command.order, sink);
+            return true;
+        case CommandType::Cancel:
+            return cancel_order(command.order.id);
+        case CommandType::Replace:
+            return replace_order(command.order.id, command.order.price,
+                                 command.order.quantity, sink) != OrderStatus::Rejected;
         }
+        return false;
+    }
 
-        return trades;
+    // Deterministic replication: apply commands numbered and stamped by an
+    // upstream sequencer (command.sequence from 1, order.timestamp). Each
+    // command's time drives the clock, so engine time comes from the input
+    // alone; Clock must be deterministic (GatewayClock or NoClock).
+    // Redelivered commands (below next_sequence()) are skipped and a gap
+    // ends the call. Returns how many commands were consumed. After each
+    // command state_hash() is chained into rolling_hash(), so replicas fed
+    // the same stream agree at every sequence number, however they batch.
+    template <typename Sink>
+    size_t apply_sequenced(const Command* commands, size_t count, Sink&& sink) {
+        static_assert(Clock::kDeterministic, "apply_sequenced needs a clock driven by the input");
+        size_t i = 0;
+        for (; i < count; i++) {
+            const Command& command = commands[i];
+            if (command.sequence < next_sequence_) continue; // Duplicate delivery
+            if (command.sequence > next_sequence_) break;    // Gap: wait for the missing one
+            clock_.stamp(command.order, clock_.now()); // Cancels and replaces move time too
+            apply(command, sink);
+            next_sequence_++;
+            rolling_hash_ = hash_combine(rolling_hash_, state_hash());
+        }
+        return i;
     }
 
-    // Cancel an existing order
-    bool cancel_order(uint64_t order_id) {
-        return book_.cancel_order(order_id);
+    uint64_t next_sequence() const { return next_sequence_; }
+
+    // Full engine image: the book (book_snapshot.hpp), then the engine
+    // section: last trade price, auction mode, pending stops, account
+    // exposure, and the apply_sequenced position and rolling hash
+    void save_snapshot(std::vector<uint8_t>& out, uint64_t journal_offset = 0) const {
+        auto write = [&](const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            out.insert(out.end(), bytes, bytes + size);
+        };
+        save_image(write, journal_offset);
+    }
+
+    // The same image written to path (renamed into place once complete), or
+    // from a forked child while matching carries on (see fork_image_file;
+    // reap with wait_snapshot)
+    bool write_snapshot_file(const char* path, uint64_t journal_offset = 0) const {
+        std::string tmp = std::string(path) + ".tmp";
+        return write_image_file(path, tmp.c_str(), [&](auto& write) { save_image(write, journal_offset); });
+    }
+    pid_t fork_snapshot(const char* path, uint64_t journal_offset = 0) const {
+        return fork_image_file(path, [&](auto& write) { save_image(write, journal_offset); });
+    }
+
+    // Restore an unused engine from save_snapshot() and return the journal
+    // offset to replay from. Everything comes back, including the sequenced
+    // stream position: afterwards state_hash(), rolling_hash() and
+    // next_sequence() equal the source's, so a standby can carry on with
+    // apply_sequenced. Returns nullopt if the image is malformed or the
+    // engine is not empty (a failed restore leaves the engine to be
+    // discarded).
+    std::optional<uint64_t> restore_snapshot(const uint8_t* data, size_t size) {
+        size_t book_size = snapshot_image_size<PriceLevels>(data, size);
+        SnapshotEngineState state;
+        if (book_size == 0 || !stops_.empty() || next_sequence_ != 1 || size - book_size < sizeof(state)) {
+            return std::nullopt;
+        }
+        std::memcpy(&state, data + book_size, sizeof(state));
+        size_t records = size_t(state.stop_count) * sizeof(SnapshotStop) +
+                         size_t(state.account_count) * sizeof(SnapshotAccount);
+        if (state.magic != kEngineStateMagic || size - book_size - sizeof(state) != records) {
+            return std::nullopt;
+        }
+        auto journal_offset = load_snapshot(book_, data, book_size);
+        if (!journal_offset) {
+            return std::nullopt;
+        }
+        const uint8_t* p = data + book_size + sizeof(state);
+        for (uint32_t i = 0; i < state.stop_count; i++, p += sizeof(SnapshotStop)) {
+            SnapshotStop stop;
+            std::memcpy(&stop, p, sizeof(stop));
+            Order order;
+            order.id = stop.id;
+            order.type = static_cast<OrderType>(stop.type);
+            order.side = static_cast<Side>(stop.side);
+            order.price = stop.price;
+            order.quantity = stop.quantity;
+            order.timestamp = std::chrono::steady_clock::time_point(
+                std::chrono::steady_clock::duration(stop.timestamp));
+            order.display_quantity = stop.display;
+            order.tif = static_cast<TimeInForce>(stop.tif);
+            order.post_only = stop.post_only != 0;
+            order.stop_price = stop.stop_price;
+            order.account = stop.account;
+            order.stp = static_cast<SelfTradePolicy>(stop.stp);
+            order.sequence = stop.sequence;
+            if (!stops_.restore(order)) return std::nullopt;
+        }
+        stops_.restore_sequence(state.stop_sequence);
+        for (uint32_t i = 0; i < state.account_count; i++, p += sizeof(SnapshotAccount)) {
+            SnapshotAccount record;
+            std::memcpy(&record, p, sizeof(record));
+            AccountExposure e;
+            e.position = record.position;
+            e.bought = record.bought;
+            e.sold = record.sold;
+            e.position_limit = record.position_limit;
+            if (!risk_.restore(record.account, e)) return std::nullopt;
+        }
+        auction_ = state.auction != 0;
+        last_price_ = state.last_price;
+        next_sequence_ = state.next_sequence;
+        rolling_hash_ = state.rolling_hash;
+        return journal_offset;
+    }
+    std::optional<uint64_t> restore_snapshot(const char* path) {
+        std::vector<uint8_t> data;
+        if (!read_image_file(path, data)) return std::nullopt;
+        return restore_snapshot(data.data(), data.size());
+    }
+
+    // Digest of the matching state: resting orders (BookConfig::state_hash
+    // must be set), pending stops, last trade price and auction mode.
+    // Account exposure follows from the fills and is not hashed.
+    uint64_t state_hash() const {
+        uint64_t h = hash_combine(book_.state_hash(), stops_.state_hash());
+        h = hash_combine(h, hash_bits(last_price_));
+        return hash_combine(h, auction_);
+    }
+
+    uint64_t rolling_hash() const { return rolling_hash_; }
+
+    // Auction call: from here until uncross(), GTC limit orders rest
+    // without matching, even when they cross. Orders that need an
+    // immediate fill (market, IOC, FOK) are rejected; cancels and replaces
+    // work as usual, without trading.
+    void begin_auction() { auction_ = true; }
+    bool in_auction() const { return auction_; }
+
+    // Price and volume uncross() would execute now (nullopt if the book
+    // does not cross)
+    std::optional<AuctionResult> indicative_uncross() const {
+        size_t point = search_equilibrium();
+        if (point == AuctionCurves<key_type>::npos) return std::nullopt;
+        uint64_t volume = std::min(curves_.demand(point), curves_.supply(point));
+        return AuctionResult{curves_.price(point), volume,
+                             std::max(curves_.demand(point), curves_.supply(point)) - volume};
+    }
+
+    // End the auction: execute every crossing order at the single price
+    // that maximizes volume (ties: least surplus, then nearest the last
+    // trade or else the crossed range's midpoint, then the lower price),
+    // in one pass down both sides in price-time priority, then resume
+    // continuous matching. Trades go to sink; returns nullopt, trading
+    // nothing, if the book does not cross.
+    template <typename Sink>
+    std::optional<AuctionResult> uncross(Sink&& sink) {
+        auction_ = false;
+        size_t point = search_equilibrium();
+        if (point == AuctionCurves<key_type>::npos) return std::nullopt;
+        AuctionResult result{curves_.price(point), 0, 0};
+        key_type key = curves_.key(point);
+        {
+            ORDERBOOK_PROBE(Stage::FillLoop);
+            auto bids = book_.template cursor<Side::Buy>();
+            auto asks = book_.template cursor<Side::Sell>();
+            // Icebergs refill as they go, so this runs past the displayed
+            // volume the search saw while both fronts still cross key
+            while (!bids.done() && !asks.done() && bids.key() >= key && asks.key() <= key) {
+                uint32_t qty = std::min(bids.front().quantity, asks.front().quantity);
+                Trade trade{bids.front().id, asks.front().id, result.price, qty};
+                risk_.record_fill(bids.front_account(), Side::Buy, qty);
+                risk_.record_fill(asks.front_account(), Side::Sell, qty);
+                bids.fill_front(qty);
+                asks.fill_front(qty);
+                result.volume += qty;
+                sink(trade);
+            }
+        }
+        uint64_t demand = curves_.demand(point);
+        uint64_t supply = curves_.supply(point);
+        result.surplus = std::max(demand, supply) - std::min(demand, supply);
+        last_price_ = result.price;
+        run_triggers(clock_.now(), sink);
+        return result;
+    }
+
+    // Fill counters for account (nullptr for 0 or out of range)
+    const AccountExposure* exposure(uint32_t account) const { return risk_.exposure(account); }
+
+    // Orders that could take account's |position| past limit if fully
+    // filled are rejected on entry. Returns false for an unknown account.
+    bool set_position_limit(uint32_t account, uint64_t limit) {
+        return risk_.set_position_limit(account, limit);
+    }
+
+    // Usage of the arena the engine allocates from (all zero on the heap)
+    ArenaStats arena_stats() const {
+        const Arena* a = arena();
+        return a ? a->stats() : ArenaStats{};
     }
 
     // Access to book state (for testing/display)
-    const OrderBook& book() const { return book_; }
+    const OrderBook<PriceLevels>& book() const { return book_; }
     
     bool has_bids() const { return book_.has_bids(); }
     bool has_asks() const { return book_.has_asks(); }
     std::optional<double> best_bid() const { return book_.best_bid_price(); }
     std::optional<double> best_ask() const { return book_.best_ask_price(); }
 
+    // L2 market data (requires BookConfig::publish_l2, see market_data.hpp)
+    template <typename F>
+    void drain_deltas(F&& f) { book_.drain_deltas(f); }
+    size_t snapshot(Side side, size_t depth, L2Level* out) const {
+        return book_.snapshot(side, depth, out);
+    }
+    uint64_t l2_sequence() const { return book_.l2_sequence(); }
+
 private:
-    OrderBook book_;
+    using key_type = typename OrderBook<PriceLevels>::key_type;
 
-    // Match a market order against the book
-    std::vector<Trade> match_market_order(Order& order) {
-        std::vector<Trade> trades;
+    // Stream the image save_snapshot() describes to write(data, size);
+    // allocation-free, so it also runs in a forked child
+    template <typename Write>
+    void save_image(Write& write, uint64_t journal_offset) const {
+        BookSnapshot<PriceLevels>::save(book_, write, journal_offset);
+        SnapshotEngineState state{};
+        state.magic = kEngineStateMagic;
+        state.auction = auction_;
+        state.last_price = last_price_;
+        state.next_sequence = next_sequence_;
+        state.rolling_hash = rolling_hash_;
+        state.stop_sequence = stops_.sequence();
+        state.stop_count = static_cast<uint32_t>(stops_.size());
+        risk_.for_each([&](uint32_t, const AccountExposure&) { state.account_count++; });
+        write(&state, sizeof(state));
+        stops_.for_each([&](const Order& order) {
+            SnapshotStop stop{};
+            stop.id = order.id;
+            stop.price = order.price;
+            stop.stop_price = order.stop_price;
+            stop.timestamp = order.timestamp.time_since_epoch().count();
+            stop.sequence = order.sequence;
+            stop.quantity = order.quantity;
+            stop.display = order.display_quantity;
+            stop.account = order.account;
+            stop.type = static_cast<uint8_t>(order.type);
+            stop.side = static_cast<uint8_t>(order.side);
+            stop.tif = static_cast<uint8_t>(order.tif);
+            stop.post_only = order.post_only;
+            stop.stp = static_cast<uint8_t>(order.stp);
+            write(&stop, sizeof(stop));
+        });
+        risk_.for_each([&](uint32_t account, const AccountExposure& e) {
+            SnapshotAccount record{account, 0, e.position, e.bought, e.sold, e.position_limit};
+            write(&record, sizeof(record));
+        });
+    }
 
-        if (order.side == Side::Buy) {
-            // Buy market order: match against asks (sellers)
-            while (order.quantity > 0 && book_.has_asks()) {
-                auto best_ask = book_.get_best_ask();
-                if (!best_ask) break;
+    std::unique_ptr<Arena> arena_; // Owned (arena_bytes > 0); declared first, freed last
+    Arena* shared_arena_;          // Caller's BookConfig::arena otherwise
+    OrderBook<PriceLevels> book_;
+    Clock clock_;
+    AccountRisk risk_;
 
-                Order& resting = best_ask->get();
-                Trade trade = execute_trade(order, resting);
-                trades.push_back(trade);
-            }
+    bool auction_ = false;
+    mutable AuctionCurves<key_type> curves_; // Price-search scratch, reused
+
+    StopBook stops_;
+    uint32_t max_stop_triggers_;
+    uint64_t next_sequence_ = 1; // apply_sequenced input
+    uint64_t rolling_hash_ = 0;
+    // NaN until the first trade: compares false, so no stop triggers
+    double last_price_ = std::numeric_limits<double>::quiet_NaN();
+
+    Arena* arena() const { return arena_ ? arena_.get() : shared_arena_; }
+
+    BookConfig with_arena(BookConfig config) const {
+        config.arena = arena();
+        return config;
+    }
+
+    void stamp(Order& order) {
+        ORDERBOOK_PROBE(Stage::Dispatch);
+        order.timestamp = clock_.stamp(order, clock_.now());
+    }
+
+    // Execute one incoming order, then release any stops its trades
+    // triggered
+    template <typename Sink>
+    OrderStatus dispatch(Order& order, Sink& sink) {
+        if (!risk_.known(order.account)) {
+            return OrderStatus::Rejected;
+        }
+        OrderStatus status;
+        if (order.type == OrderType::Stop || order.type == OrderType::StopLimit) {
+            status = enter_stop(order, sink);
+        } else if (pending_stop(order.id)) {
+            status = OrderStatus::Rejected; // Duplicate ID
         } else {
-            // Sell market order: match against bids (buyers)
-            while (order.quantity > 0 && book_.has_bids()) {
-                auto best_bid = book_.get_best_bid();
-                if (!best_bid) break;
+            status = execute(order, sink);
+        }
+        if (!stops_.empty()) {
+            run_triggers(order.timestamp, sink);
+        }
+        return status;
+    }
 
-                Order& resting = best_bid->get();
-                Trade trade = execute_trade(order, resting);
-                trades.push_back(trade);
-            }
+    // A new order may not reuse the ID of a stop waiting to trigger
+    bool pending_stop(uint64_t id) const { return !stops_.empty() && stops_.contains(id); }
+
+    template <typename Sink>
+    OrderStatus execute(Order& order, Sink& sink) {
+        if (!risk_.within_limit(order)) {
+            return OrderStatus::Rejected; // Position limit
+        }
+        if (auction_) {
+            return rest_for_auction(order);
         }
+        if (order.type != OrderType::Market && order.type != OrderType::Limit) {
+            return OrderStatus::Rejected;
+        }
+        // One indexed call picks the match loop for this side and type
+        using Matcher = OrderStatus (MatchingEngine::*)(Order&, Sink&);
+        static constexpr Matcher kMatchers[2][2] = {
+            {&MatchingEngine::template match_order<Side::Buy, OrderType::Market, Sink>,
+             &MatchingEngine::template match_order<Side::Buy, OrderType::Limit, Sink>},
+            {&MatchingEngine::template match_order<Side::Sell, OrderType::Market, Sink>,
+             &MatchingEngine::template match_order<Side::Sell, OrderType::Limit, Sink>}};
+        Matcher matcher = kMatchers[static_cast<size_t>(order.side)][static_cast<size_t>(order.type)];
+        return (this->*matcher)(order, sink);
+    }
 
-        // Any unfilled market order quantity is lost (no book placement)
-        return trades;
+    OrderStatus rest_for_auction(const Order& order) {
+        if (order.type != OrderType::Limit || order.tif != TimeInForce::GTC || order.quantity == 0) {
+            return OrderStatus::Rejected; // Needs an immediate fill
+        }
+        return book_.add_order(order) ? OrderStatus::Resting : OrderStatus::Rejected;
     }
 
-    // Match a limit order against the book, then place remainder
-    std::vector<Trade> match_limit_order(Order& order) {
-        std::vector<Trade> trades;
+    // Cumulative curves over the crossed range, then the equilibrium point
+    // in curves_ (npos if nothing crosses)
+    size_t search_equilibrium() const {
+        curves_.clear();
+        auto bid = book_.best_bid_price();
+        auto ask = book_.best_ask_price();
+        if (!bid || !ask || *bid < *ask) return AuctionCurves<key_type>::npos;
+        key_type low = *book_.to_key(*ask);
+        key_type high = *book_.to_key(*bid);
+        book_.for_each_level(Side::Buy, [&](key_type key, const PriceLevel& level) {
+            if (key < low) return false;
+            curves_.add_bid(key, book_.to_price(key), level.total_quantity);
+            return true;
+        });
+        book_.for_each_level(Side::Sell, [&](key_type key, const PriceLevel& level) {
+            if (key > high) return false;
+            curves_.add_ask(key, book_.to_price(key), level.total_quantity);
+            return true;
+        });
+        curves_.build();
+        double reference = std::isnan(last_price_) ? (*bid + *ask) / 2 : last_price_;
+        return curves_.equilibrium(reference);
+    }
 
-        if (order.side == Side::Buy) {
-            // Buy limit: match against asks if price >= best ask
-            while (order.quantity > 0 && book_.has_asks()) {
-                auto best_ask_price = book_.best_ask_price();
-                if (!best_ask_price || order.price < *best_ask_price) {
-                    break; // Can't match: our buy price is below best ask
-                }
+    // A stop whose trigger the last trade has already reached executes at
+    // once; otherwise it waits in the stop book
+    template <typename Sink>
+    OrderStatus enter_stop(Order& order, Sink& sink) {
+        bool reached = order.side == Side::Buy ? last_price_ >= order.stop_price
+                                               : last_price_ <= order.stop_price;
+        if (reached) {
+            trigger(order);
+            return execute(order, sink);
+        }
+        if (book_.find_slot(order.id) != kNullSlot || !stops_.add(order)) {
+            return OrderStatus::Rejected; // Duplicate ID
+        }
+        return OrderStatus::Pending;
+    }
 
-                auto best_ask = book_.get_best_ask();
-                if (!best_ask) break;
+    static void trigger(Order& order) {
+        order.type = order.type == OrderType::Stop ? OrderType::Market : OrderType::Limit;
+    }
 
-                Order& resting = best_ask->get();
-                Trade trade = execute_trade(order, resting);
-                trades.push_back(trade);
+    // Release stops triggered by the last trade price, nearest stop first,
+    // at most max_stop_triggers_ per call so a cascade's latency is bounded.
+    // Each released order can move the price and trigger more in the same
+    // loop; whatever is left runs on the next call (or process_stops()).
+    template <typename Sink>
+    void run_triggers(std::chrono::steady_clock::time_point now, Sink& sink) {
+        for (uint32_t n = 0; n < max_stop_triggers_ && stops_.triggered(last_price_); n++) {
+            Order order = stops_.pop_triggered(last_price_);
+            trigger(order);
+            order.timestamp = now;
+            if constexpr (HearsTriggers<Sink>::value) {
+                const Order released = order;
+                uint32_t executed = 0;
+                auto counted = [&](const Trade& trade) {
+                    executed += trade.quantity;
+                    sink(trade);
+                };
+                OrderStatus status = execute(order, counted);
+                sink.on_triggered(released, status, executed);
+            } else {
+                execute(order, sink);
+            }
+        }
+    }
+
+    // A non-crossing order of this kind simply rests, so it can join a run.
+    // Orders with an account go through dispatch() for the risk checks.
+    static bool restable(const Order& order) {
+        return order.type == OrderType::Limit && order.quantity > 0 && order.tif == TimeInForce::GTC &&
+               order.account == 0;
+    }
+
+    static bool same_level(const Order& a, const Order& b) {
+        return restable(a) && a.side == b.side && a.price == b.price;
+    }
+
+    // Match an incoming market or limit order on side S, then settle its
+    // remainder: a market remainder is dropped, a GTC limit remainder rests
+    template <Side S, OrderType T, typename Sink>
+    OrderStatus match_order(Order& order, Sink& sink) {
+        key_type limit{};
+        if constexpr (T == OrderType::Limit) {
+            auto key = book_.to_key(order.price);
+            if (!key) {
+                return OrderStatus::Rejected; // Price not representable by this book
+            }
+            limit = *key;
+            // Time in force / post-only checks that need no fill to decide
+            if (order.post_only && book_.crosses(S, limit)) {
+                return OrderStatus::Rejected; // Would take liquidity
+            }
+            if (order.tif == TimeInForce::FOK && !fillable<S, T>(order, limit)) {
+                return OrderStatus::Cancelled;
             }
         } else {
-            // Sell limit: match against bids if price <= best bid
-            while (order.quantity > 0 && book_.has_bids()) {
-                auto best_bid_price = book_.best_bid_price();
-                if (!best_bid_price || order.price > *best_bid_price) {
-                    break; // Can't match: our sell price is above best bid
-                }
+            if (order.tif == TimeInForce::FOK && !fillable<S, T>(order, limit)) {
+                return OrderStatus::Cancelled; // Decided before any fill
+            }
+        }
+        uint32_t original_quantity = order.quantity;
+        bool prevented = match<S, T>(order, limit, sink);
 
-                auto best_bid = book_.get_best_bid();
-                if (!best_bid) break;
+        if constexpr (T == OrderType::Market) {
+            // Any unfilled market order quantity is lost (no book placement)
+            return order.quantity == 0 && !prevented ? OrderStatus::Filled : OrderStatus::Cancelled;
+        } else {
+            // Place any remaining quantity on the book
+            if (order.quantity == 0) {
+                return prevented ? OrderStatus::Cancelled : OrderStatus::Filled;
+            }
+            if (order.tif != TimeInForce::GTC) {
+                return OrderStatus::Cancelled; // IOC remainder: no resting node
+            }
+            if (book_.add_order(order)) {
+                return OrderStatus::Resting;
+            }
+            return order.quantity < original_quantity ? OrderStatus::Cancelled : OrderStatus::Rejected;
+        }
+    }
+
+    template <typename Sink>
+    OrderStatus replace(uint64_t order_id, double new_price, uint32_t new_quantity,
+                        std::chrono::steady_clock::time_point now, Sink& sink) {
+        uint32_t slot = book_.find_slot(order_id);
+        auto key = book_.to_key(new_price);
+        if (slot == kNullSlot || !key) {
+            return OrderStatus::Rejected;
+        }
+        if (new_quantity == 0) {
+            book_.erase_slot(slot);
+            return OrderStatus::Cancelled;
+        }
+
+        Order order;
+        order.id = order_id;
+        order.type = OrderType::Limit;
+        order.side = book_.resting(slot).side;
+        order.price = new_price;
+        order.quantity = new_quantity;
+        order.timestamp = now;
+        order.account = book_.resting_meta(slot).account;
+        order.stp = book_.resting_meta(slot).stp;
+        if (!risk_.within_limit(order)) {
+            return OrderStatus::Rejected;
+        }
+        if (!auction_ && *key != book_.resting(slot).price && book_.crosses(order.side, *key)) {
+            if (book_.resting(slot).flags & kOrderFlagPostOnly) {
+                return OrderStatus::Rejected; // Would take liquidity
+            }
+            // The node itself is on the other side
+            bool prevented = order.side == Side::Buy ? match<Side::Buy, OrderType::Limit>(order, *key, sink)
+                                                     : match<Side::Sell, OrderType::Limit>(order, *key, sink);
+            if (order.quantity == 0) {
+                book_.erase_slot(slot);
+                return prevented ? OrderStatus::Cancelled : OrderStatus::Filled;
+            }
+        }
+        if (book_.amend(slot, *key, order.quantity, order.timestamp)) {
+            return OrderStatus::Resting;
+        }
+        if (order.quantity == new_quantity) {
+            return OrderStatus::Rejected; // Outside the ladder, nothing traded
+        }
+        book_.erase_slot(slot);
+        return OrderStatus::Cancelled;
+    }
 
-                Order& resting = best_bid->get();
-                Trade trade = execute_trade(order, resting);
-                trades.push_back(trade);
+    // The match loop, written once: order (on side S) trades against the
+    // opposite side's front orders until it is filled, the side is empty
+    // or, for a limit order, the best opposite price no longer crosses
+    // limit. The opposite book, price test and trade fields are all fixed
+    // at compile time. Returns true if self-trade prevention took quantity
+    // from order.
+    template <Side S, OrderType T, typename Sink>
+    bool match(Order& order, key_type limit, Sink& sink) {
+        ORDERBOOK_PROBE(Stage::FillLoop);
+        auto level = book_.template cursor<opposite(S)>();
+        bool prevented = false;
+        while (order.quantity > 0 && !level.done()) {
+            if constexpr (T == OrderType::Limit) {
+                if (S == Side::Buy ? level.key() > limit : level.key() < limit) {
+                    break; // Best opposite price is through our limit
+                }
             }
+            prevented |= take_front<S>(order, level, sink);
         }
+        return prevented;
+    }
 
-        // Place any remaining quantity on the book
-        if (order.quantity > 0) {
-            book_.add_order(order);
+    // FOK's up-front check: could order fill in full on arrival? With
+    // self-trade prevention only liquidity it would trade with counts.
+    template <Side S, OrderType T>
+    bool fillable(const Order& order, key_type limit) const {
+        if constexpr (T == OrderType::Limit) {
+            return guards_self(order) ? book_.can_fill(S, limit, order.quantity, order.account, order.stp)
+                                      : book_.can_fill(S, limit, order.quantity);
+        } else {
+            return guards_self(order) ? book_.can_fill(S, order.quantity, order.account, order.stp)
+                                      : book_.can_fill(S, order.quantity);
         }
+    }
 
-        return trades;
+    // Self-trade prevention applies to this incoming order
+    static bool guards_self(const Order& order) {
+        return order.stp != SelfTradePolicy::None && order.account != 0;
     }
 
-    // Execute a trade between incoming order and resting order
-    Trade execute_trade(Order& incoming, Order& resting) {
+    static constexpr Side opposite(Side side) { return side == Side::Buy ? Side::Sell : Side::Buy; }
+
+    // One step of a match loop against the cursor's front order: a trade,
+    // or the incoming order's self-trade policy if both share an account.
+    // Returns true if the policy took quantity from the incoming order.
+    template <Side S, typename Cursor, typename Sink>
+    bool take_front(Order& incoming, Cursor& level, Sink& sink) {
+        if (guards_self(incoming) && level.front_account() == incoming.account) {
+            switch (incoming.stp) {
+            case SelfTradePolicy::CancelOldest:
+                level.pop_front();
+                return false;
+            case SelfTradePolicy::DecrementBoth: {
+                uint32_t qty = std::min(incoming.quantity, level.front().quantity);
+                incoming.quantity -= qty;
+                level.fill_front(qty);
+                return true;
+            }
+            default:
+                incoming.quantity = 0; // CancelNewest: ends the loop
+                return true;
+            }
+        }
+        sink(execute_trade<S>(incoming, level));
+        return false;
+    }
+
+    // Execute a trade between incoming order and the front resting order at
+    // the cursor's level
+    template <Side S, typename Cursor>
+    Trade execute_trade(Order& incoming, Cursor& level) {
+        auto& resting = level.front();
         uint32_t fill_qty = std::min(incoming.quantity, resting.quantity);
-        double fill_price = resting.price; // Price-time priority: resting order's price
+        double fill_price = level.price(); // Price-time priority: resting order's price
 
         Trade trade;
-        if (incoming.side == Side::Buy) {
+        if constexpr (S == Side::Buy) {
             trade.buy_order_id = incoming.id;
             trade.sell_order_id = resting.id;
         } else {
@@ -136,17 +766,13 @@ private:
         }
         trade.price = fill_price;
         trade.quantity = fill_qty;
+        last_price_ = fill_price; // Stop trigger reference
+        risk_.record_fill(incoming.account, S, fill_qty);
+        risk_.record_fill(level.front_account(), opposite(S), fill_qty);
 
-        // Update quantities
+        // Update quantities; a filled resting order is removed in place
         incoming.quantity -= fill_qty;
-        resting.quantity -= fill_qty;
-
-        // Remove or update resting order
-        if (resting.quantity == 0) {
-            book_.cancel_order(resting.id);
-        } else {
-            book_.modify_quantity(resting.id, resting.quantity);
-        }
+        level.fill_front(fill_qty);
 
         return trade;
     }
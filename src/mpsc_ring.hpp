@@ -0,0 +1,84 @@
+#ifndef MPSC_RING_HPP
+#define MPSC_RING_HPP
+
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace orderbook {
+
+// Bounded lock-free multi-producer / single-consumer ring.
+// Each slot carries a sequence number: producers claim a position with one
+// CAS on the shared tail, write the value, then publish it by bumping the
+// slot's sequence; the consumer reads slots in order without any RMW.
+// N must be a power of two.
+template <typename T, size_t N>
+class MpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "MpscRing size must be a power of two");
+
+public:
+    MpscRing() {
+        for (size_t i = 0; i < N; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread: false if the ring is full
+    bool try_push(const T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[pos & (N - 1)];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // Slot still holds an unconsumed value
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = value;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only: false if the next value is not yet published
+    bool try_pop(T& out) {
+        Slot& slot = slots_[head_ & (N - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        out = slot.value;
+        slot.sequence.store(head_ + N, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+    // Consumer only: pop up to max values, returns the number popped
+    size_t pop_batch(T* out, size_t max) {
+        size_t n = 0;
+        while (n < max && try_pop(out[n])) {
+            n++;
+        }
+        return n;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    alignas(kCacheLine) std::atomic<size_t> tail_{0}; // Shared by producers
+    alignas(kCacheLine) size_t head_ = 0;             // Consumer-owned
+    alignas(kCacheLine) Slot slots_[N];
+};
+
+} // namespace orderbook
+
+#endif // MPSC_RING_HPP
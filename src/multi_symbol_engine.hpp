@@ -0,0 +1,167 @@
+#ifndef MULTI_SYMBOL_ENGINE_HPP
+#define MULTI_SYMBOL_ENGINE_HPP
+
+#include "matching_engine.hpp"
+#include "command.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace orderbook {
+
+// Routes commands by symbol ID to independent per-symbol MatchingEngines.
+//
+// Symbols are partitioned across shards (symbol % num_shards). Each shard is
+// one busy-polling worker thread, optionally pinned to a core, that owns its
+// engines outright: they are constructed on the worker thread, so their
+// pools, indices and level stores are first-touched by the core that uses
+// them, and nothing is shared between shards. The only cross-thread traffic
+// is one SPSC ingress ring per shard.
+//
+// submit()/try_submit() must be called from a single routing thread.
+// Handler is invoked as handler(symbol, trade) on the owning shard's thread;
+// each shard gets its own copy.
+template <typename PriceLevels = MapPriceLevels, typename Handler = void (*)(uint32_t, const Trade&)>
+class MultiSymbolEngine {
+public:
+    using Engine = MatchingEngine<PriceLevels>;
+    static constexpr size_t kIngressSize = 4096; // Commands per shard ring
+
+    struct Config {
+        size_t num_shards = 1;
+        uint32_t num_symbols = 1;
+        BookConfig book;       // Used for every symbol's book; book.arena is ignored
+                               // (see BookConfig::arena), book.arena_bytes gives
+                               // each engine its own arena on its shard's thread
+        bool pin_threads = true;
+        unsigned first_cpu = 0; // Shard i runs on CPU (first_cpu + i) % ncpu
+    };
+
+    // Per-shard counters, written only by the shard thread
+    struct ShardStats {
+        uint64_t commands; // Commands applied
+        uint64_t trades;   // Trades produced
+    };
+
+    MultiSymbolEngine(const Config& config, Handler handler)
+        : config_(config) {
+        config_.book.arena = nullptr; // Unsynchronized: must not be shared across shards
+        shards_.reserve(config.num_shards);
+        for (size_t i = 0; i < config.num_shards; i++) {
+            shards_.push_back(std::make_unique<Shard>(handler));
+        }
+        for (size_t i = 0; i < config.num_shards; i++) {
+            shards_[i]->thread = std::thread([this, i] { run_shard(i); });
+        }
+    }
+
+    ~MultiSymbolEngine() { stop(); }
+
+    MultiSymbolEngine(const MultiSymbolEngine&) = delete;
+    MultiSymbolEngine& operator=(const MultiSymbolEngine&) = delete;
+
+    // Enqueue a command for its symbol's shard; false if that ring is full
+    bool try_submit(const Command& command) {
+        return shard_for(command.symbol).ingress.try_push(command);
+    }
+
+    // Enqueue a command, spinning while the shard's ring is full
+    void submit(const Command& command) {
+        Shard& shard = shard_for(command.symbol);
+        while (!shard.ingress.try_push(command)) {
+            cpu_relax();
+        }
+    }
+
+    // Drain every ring, then join the workers. Idempotent.
+    void stop() {
+        running_.store(false, std::memory_order_release);
+        for (auto& shard : shards_) {
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
+        }
+    }
+
+    size_t num_shards() const { return shards_.size(); }
+    size_t shard_of(uint32_t symbol) const { return symbol % shards_.size(); }
+
+    // Safe to call from any thread while running (relaxed reads)
+    ShardStats shard_stats(size_t shard) const {
+        const Counters& c = shards_[shard]->counters;
+        return {c.commands.load(std::memory_order_relaxed),
+                c.trades.load(std::memory_order_relaxed)};
+    }
+
+    // Book access for inspection; only valid after stop()
+    const Engine& engine(uint32_t symbol) const {
+        return shards_[shard_of(symbol)]->engines[symbol / shards_.size()];
+    }
+
+private:
+    struct alignas(kCacheLine) Counters {
+        std::atomic<uint64_t> commands{0};
+        std::atomic<uint64_t> trades{0};
+    };
+
+    struct Shard {
+        explicit Shard(Handler h) : handler(std::move(h)) {}
+
+        SpscRing<Command, kIngressSize> ingress;
+        Counters counters;
+        std::vector<Engine> engines; // Indexed by symbol / num_shards
+        Handler handler;
+        std::thread thread;
+    };
+
+    Config config_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<bool> running_{true};
+
+    Shard& shard_for(uint32_t symbol) { return *shards_[shard_of(symbol)]; }
+
+    void run_shard(size_t index) {
+        Shard& shard = *shards_[index];
+        if (config_.pin_threads) {
+            pin_to_cpu(config_.first_cpu + static_cast<unsigned>(index));
+        }
+
+        // Build this shard's books on its own thread
+        size_t n = shards_.size();
+        size_t local_symbols = (config_.num_symbols + n - 1 - index) / n;
+        shard.engines.reserve(local_symbols);
+        for (size_t i = 0; i < local_symbols; i++) {
+            shard.engines.emplace_back(config_.book);
+        }
+
+        // Single writer: plain load + store instead of atomic RMW
+        uint64_t commands = 0;
+        uint64_t trades = 0;
+        Command command;
+        for (;;) {
+            if (!shard.ingress.try_pop(command)) {
+                if (!running_.load(std::memory_order_acquire) && shard.ingress.empty()) {
+                    break;
+                }
+                cpu_relax();
+                continue;
+            }
+            uint32_t symbol = command.symbol;
+            if (symbol < config_.num_symbols) {
+                shard.engines[symbol / n].apply(command, [&](const Trade& trade) {
+                    trades++;
+                    shard.handler(symbol, trade);
+                });
+            }
+            commands++;
+            shard.counters.commands.store(commands, std::memory_order_relaxed);
+            shard.counters.trades.store(trades, std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace orderbook
+
+#endif // MULTI_SYMBOL_ENGINE_HPP
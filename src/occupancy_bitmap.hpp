@@ -0,0 +1,143 @@
+#ifndef OCCUPANCY_BITMAP_HPP
+#define OCCUPANCY_BITMAP_HPP
+
+#include "arena.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace orderbook {
+
+// Two-level bitmap of occupied positions (price ticks): one bit per
+// position and one summary bit per 64-position word. The nearest set bit
+// in either direction is a ctz/clz in the current word, one in the summary
+// and one in the word it points to. Only a gap longer than 4096 positions
+// scans further, over summary words only, 4 (AVX2) or 2 (NEON) at a time.
+class OccupancyBitmap {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit OccupancyBitmap(size_t size, Arena* arena = nullptr)
+        : size_(size), words_((size + 63) / 64, 0, ArenaAllocator<uint64_t>(arena)),
+          summary_((words_.size() + 63) / 64, 0, ArenaAllocator<uint64_t>(arena)) {}
+
+    size_t size() const { return size_; }
+
+    bool test(size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+
+    void set(size_t i) {
+        words_[i >> 6] |= bit(i);
+        summary_[i >> 12] |= bit(i >> 6);
+    }
+
+    void clear(size_t i) {
+        uint64_t& word = words_[i >> 6];
+        word &= ~bit(i);
+        if (word == 0) {
+            summary_[i >> 12] &= ~bit(i >> 6);
+        }
+    }
+
+    // Lowest set position >= from, or npos
+    size_t find_next(size_t from) const {
+        if (from >= size_) return npos;
+        size_t w = from >> 6;
+        uint64_t m = words_[w] & (~uint64_t(0) << (from & 63));
+        if (m) return (w << 6) + ctz(m);
+        w = next_word(w + 1);
+        return w == npos ? npos : (w << 6) + ctz(words_[w]);
+    }
+
+    // Highest set position <= from, or npos (from may be past the end)
+    size_t find_prev(size_t from) const {
+        if (size_ == 0) return npos;
+        if (from >= size_) from = size_ - 1;
+        size_t w = from >> 6;
+        uint64_t m = words_[w] & (~uint64_t(0) >> (63 - (from & 63)));
+        if (m) return (w << 6) + 63 - clz(m);
+        if (w == 0) return npos;
+        w = prev_word(w - 1);
+        return w == npos ? npos : (w << 6) + 63 - clz(words_[w]);
+    }
+
+private:
+    size_t size_;
+    ArenaVector<uint64_t> words_;   // Bit i: position i occupied
+    ArenaVector<uint64_t> summary_; // Bit w: words_[w] != 0
+
+    static uint64_t bit(size_t i) { return uint64_t(1) << (i & 63); }
+    static unsigned ctz(uint64_t m) { return static_cast<unsigned>(__builtin_ctzll(m)); }
+    static unsigned clz(uint64_t m) { return static_cast<unsigned>(__builtin_clzll(m)); }
+
+    // Lowest non-empty word index >= w, or npos
+    size_t next_word(size_t w) const {
+        if (w >= words_.size()) return npos;
+        size_t s = w >> 6;
+        uint64_t m = summary_[s] & (~uint64_t(0) << (w & 63));
+        if (m) return (s << 6) + ctz(m);
+        s = first_nonzero(s + 1);
+        return s == npos ? npos : (s << 6) + ctz(summary_[s]);
+    }
+
+    // Highest non-empty word index <= w, or npos
+    size_t prev_word(size_t w) const {
+        size_t s = w >> 6;
+        uint64_t m = summary_[s] & (~uint64_t(0) >> (63 - (w & 63)));
+        if (m) return (s << 6) + 63 - clz(m);
+        if (s == 0) return npos;
+        s = last_nonzero(s - 1);
+        return s == npos ? npos : (s << 6) + 63 - clz(summary_[s]);
+    }
+
+    // First summary word at or after s that is non-zero
+    size_t first_nonzero(size_t s) const {
+        const uint64_t* p = summary_.data();
+        size_t n = summary_.size();
+#if defined(__AVX2__)
+        for (; s + 4 <= n; s += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + s));
+            if (!_mm256_testz_si256(v, v)) break;
+        }
+#elif defined(__ARM_NEON)
+        for (; s + 2 <= n; s += 2) {
+            uint64x2_t v = vld1q_u64(p + s);
+            if (vmaxvq_u32(vreinterpretq_u32_u64(v)) != 0) break;
+        }
+#endif
+        for (; s < n; s++) {
+            if (p[s]) return s;
+        }
+        return npos;
+    }
+
+    // Last summary word at or before s that is non-zero
+    size_t last_nonzero(size_t s) const {
+        const uint64_t* p = summary_.data();
+        size_t end = s + 1; // Words [0, end) remain
+#if defined(__AVX2__)
+        for (; end >= 4; end -= 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + end - 4));
+            if (!_mm256_testz_si256(v, v)) break;
+        }
+#elif defined(__ARM_NEON)
+        for (; end >= 2; end -= 2) {
+            uint64x2_t v = vld1q_u64(p + end - 2);
+            if (vmaxvq_u32(vreinterpretq_u32_u64(v)) != 0) break;
+        }
+#endif
+        for (; end > 0; end--) {
+            if (p[end - 1]) return end - 1;
+        }
+        return npos;
+    }
+};
+
+} // namespace orderbook
+
+#endif // OCCUPANCY_BITMAP_HPP
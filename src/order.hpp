@@ -6,16 +6,44 @@
 
 namespace orderbook {
 
-enum class OrderType {
+enum class OrderType : uint8_t {
     Market,
-    Limit
+    Limit,
+    Stop,     // Becomes Market when the last trade reaches stop_price
+    StopLimit // Becomes Limit at price when the last trade reaches stop_price
 };
 
-enum class Side {
+enum class Side : uint8_t {
     Buy,
     Sell
 };
 
+// How long an order's unfilled quantity may stay on the book
+enum class TimeInForce : uint8_t {
+    GTC, // Good till cancelled: remainder rests
+    IOC, // Immediate or cancel: remainder discarded
+    FOK  // Fill or kill: executed in full on arrival or not at all
+};
+
+// What to do when an incoming order would trade with a resting order of
+// the same account (the incoming order's choice). FOK's up-front check
+// leaves out the account's own resting liquidity.
+enum class SelfTradePolicy : uint8_t {
+    None,         // Trade anyway
+    CancelNewest, // Cancel the rest of the incoming order
+    CancelOldest, // Cancel the resting order, keep matching
+    DecrementBoth // Reduce both by the smaller quantity, no trade
+};
+
+// Outcome of processing one incoming order
+enum class OrderStatus : uint8_t {
+    Resting,   // Remainder placed on the book (possibly after fills)
+    Filled,    // Fully executed
+    Cancelled, // Partly or not executed; remainder discarded
+    Rejected,  // Not accepted (unrepresentable price, duplicate ID, ...)
+    Pending    // Stop order parked until triggered
+};
+
 struct Order {
     uint64_t id;
     OrderType type;
@@ -23,6 +51,13 @@ struct Order {
     double price;
     uint32_t quantity;
     std::chrono::steady_clock::time_point timestamp;
+    uint32_t display_quantity = 0; // Iceberg slice shown on the book (0 = all of quantity)
+    TimeInForce tif = TimeInForce::GTC;
+    bool post_only = false;        // Limit only: rejected rather than trade on arrival
+    double stop_price = 0.0;       // Stop / StopLimit trigger (last trade price)
+    uint64_t sequence = 0;         // Set by the book (stop book while pending): arrival order (read back only)
+    uint32_t account = 0;          // Owner, for self-trade prevention and exposure (0 = none)
+    SelfTradePolicy stp = SelfTradePolicy::None;
 };
 
 } // namespace orderbook
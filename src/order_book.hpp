@@ -2,94 +2,304 @@
 #define ORDER_BOOK_HPP
 
 #include "order.hpp"
-#include <map>
-#include <list>
-#include <unordered_map>
+#include "book_config.hpp"
+#include "price_levels.hpp"
+#include "order_pool.hpp"
+#include "order_index.hpp"
+#include "market_data.hpp"
+#include "instrumentation.hpp"
+#include "state_hash.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
 #include <optional>
 #include <functional>
+#include <limits>
 
 namespace orderbook {
 
-// A price level contains a queue of orders (FIFO)
-using OrderQueue = std::list<Order>;
+template <typename PriceLevels>
+struct BookSnapshot;
 
+// Which resting orders OrderBook::mass_cancel removes: all that match
+// every field given
+struct MassCancelFilter {
+    uint32_t account = 0;      // Owner (0 = any owner, or none)
+    std::optional<Side> side;  // nullopt: both sides
+    double min_price = -std::numeric_limits<double>::infinity();
+    double max_price = std::numeric_limits<double>::infinity();
+};
+
+// PriceLevels selects how price levels are stored (see price_levels.hpp):
+// MapPriceLevels (std::map on double) or TickLadderPriceLevels (dense array
+// of integer ticks).
+template <typename PriceLevels = MapPriceLevels>
 class OrderBook {
+    template <Side S>
+    using Levels = typename PriceLevels::template Store<PriceLevel, S>;
+
 public:
+    using key_type = typename Levels<Side::Buy>::key_type;
+    using Pool = OrderPool<key_type>;
+    using Resting = RestingOrder<key_type>;
+
+    OrderBook() : OrderBook(BookConfig{}) {}
+    explicit OrderBook(const BookConfig& config)
+        : bids_(config), asks_(config), pool_(config.order_pool_capacity, config.arena),
+          order_index_(config.order_pool_capacity, config.direct_index_window, config.arena),
+          account_heads_(config.max_accounts, kNullSlot, ArenaAllocator<uint32_t>(config.arena)),
+          settle_(ArenaAllocator<std::pair<Side, key_type>>(config.arena)),
+          hash_state_(config.state_hash), publish_l2_(config.publish_l2),
+          deltas_(ArenaAllocator<L2Delta>(config.arena)) {}
+
     // Add a limit order to the book
-    // Returns true if added, false if order ID already exists
+    // Returns true if added, false if order ID already exists, the price
+    // cannot be stored (off the tick grid / outside the ladder) or the
+    // account is not below BookConfig::max_accounts
     bool add_order(const Order& order) {
         if (order.type != OrderType::Limit) {
             return false; // Only limit orders go on the book
         }
-        if (order_locations_.count(order.id)) {
-            return false; // Duplicate ID
+        auto key = bids_.to_key(order.price);
+        if (!key) {
+            return false;
         }
 
         if (order.side == Side::Buy) {
-            auto& queue = bids_[order.price];
-            queue.push_back(order);
-            auto it = std::prev(queue.end());
-            order_locations_[order.id] = {order.side, order.price, it};
+            return insert(bids_, &order, 1, *key, order.timestamp) == 1;
         } else {
-            auto& queue = asks_[order.price];
-            queue.push_back(order);
-            auto it = std::prev(queue.end());
-            order_locations_[order.id] = {order.side, order.price, it};
+            return insert(asks_, &order, 1, *key, order.timestamp) == 1;
+        }
+    }
+
+    // Add a run of limit orders that share side and price, in FIFO order,
+    // finding their level once and stamping them all with timestamp.
+    // Returns how many were added (duplicate IDs and unknown accounts are
+    // skipped).
+    size_t add_run(const Order* orders, size_t n, std::chrono::steady_clock::time_point timestamp) {
+        if (n == 0 || orders[0].type != OrderType::Limit) {
+            return 0;
+        }
+        auto key = bids_.to_key(orders[0].price);
+        if (!key) {
+            return 0;
+        }
+        if (orders[0].side == Side::Buy) {
+            return insert(bids_, orders, n, *key, timestamp);
+        } else {
+            return insert(asks_, orders, n, *key, timestamp);
+        }
+    }
+
+    // True if a limit order on side at limit would trade on arrival
+    bool crosses(Side side, key_type limit) const {
+        if (side == Side::Buy) {
+            return !asks_.empty() && asks_.best_key() <= limit;
+        }
+        return !bids_.empty() && bids_.best_key() >= limit;
+    }
+
+    // True if an incoming order on side could fill quantity against the
+    // displayed liquidity at prices up to limit. Answered from the side and
+    // level aggregates without touching orders; iceberg reserves are not
+    // counted.
+    bool can_fill(Side side, key_type limit, uint64_t quantity) const {
+        if (side == Side::Buy) {
+            return ask_totals_.quantity >= quantity &&
+                   available(asks_, quantity, [limit](key_type key) { return key <= limit; });
+        }
+        return bid_totals_.quantity >= quantity &&
+               available(bids_, quantity, [limit](key_type key) { return key >= limit; });
+    }
+
+    // As above at any price (market orders)
+    bool can_fill(Side side, uint64_t quantity) const {
+        auto any = [](key_type) { return true; };
+        if (side == Side::Buy) {
+            return ask_totals_.quantity >= quantity && available(asks_, quantity, any);
+        }
+        return bid_totals_.quantity >= quantity && available(bids_, quantity, any);
+    }
+
+    // As above for an incoming order of account that prevents self-trades
+    // under stp: only liquidity matching would trade with counts. Orders of
+    // account are skipped (CancelOldest) or end the count (CancelNewest,
+    // DecrementBoth: matching stops short there). Walks orders in FIFO
+    // order rather than reading level aggregates.
+    bool can_fill(Side side, key_type limit, uint64_t quantity, uint32_t account, SelfTradePolicy stp) const {
+        if (side == Side::Buy) {
+            return available(asks_, quantity, [limit](key_type key) { return key <= limit; }, account, stp);
+        }
+        return available(bids_, quantity, [limit](key_type key) { return key >= limit; }, account, stp);
+    }
+
+    bool can_fill(Side side, uint64_t quantity, uint32_t account, SelfTradePolicy stp) const {
+        auto any = [](key_type) { return true; };
+        if (side == Side::Buy) {
+            return available(asks_, quantity, any, account, stp);
+        }
+        return available(bids_, quantity, any, account, stp);
+    }
+
+    // Hint the cache about the state an incoming order will touch: its
+    // order-index entry and (where the store can address it) its level
+    void prefetch(const Order& order) const {
+        order_index_.prefetch(order.id);
+        if (auto key = bids_.to_key(order.price)) {
+            if (order.side == Side::Buy) {
+                bids_.prefetch(*key);
+            } else {
+                asks_.prefetch(*key);
+            }
         }
-        return true;
     }
 
     // Cancel an order by ID
     // Returns true if cancelled, false if not found
     bool cancel_order(uint64_t order_id) {
-        auto loc_it = order_locations_.find(order_id);
-        if (loc_it == order_locations_.end()) {
+        uint32_t slot = index_erase(order_id);
+        if (slot == kNullSlot) {
             return false;
         }
 
-        const auto& loc = loc_it->second;
-        if (loc.side == Side::Buy) {
-            auto& queue = bids_[loc.price];
-            queue.erase(loc.iterator);
-            if (queue.empty()) {
-                bids_.erase(loc.price);
-            }
+        if (pool_[slot].side == Side::Buy) {
+            remove(bids_, slot);
         } else {
-            auto& queue = asks_[loc.price];
-            queue.erase(loc.iterator);
-            if (queue.empty()) {
-                asks_.erase(loc.price);
-            }
+            remove(asks_, slot);
         }
-        order_locations_.erase(loc_it);
         return true;
     }
 
-    // Modify order quantity (for partial fills)
+    // Modify order quantity (for partial fills); an iceberg's displayed
+    // slice, its reserve is left alone
     // Returns true if modified, false if not found
     bool modify_quantity(uint64_t order_id, uint32_t new_quantity) {
-        auto loc_it = order_locations_.find(order_id);
-        if (loc_it == order_locations_.end()) {
+        uint32_t slot = order_index_.find(order_id);
+        if (slot == kNullSlot) {
             return false;
         }
-        loc_it->second.iterator->quantity = new_quantity;
+        Resting& order = pool_[slot];
+        PriceLevel& level = *find_level(order.side, order.price);
+        SideTotals& side = totals(order.side);
+        level.total_quantity += new_quantity;
+        level.total_quantity -= order.quantity;
+        side.quantity += new_quantity;
+        side.quantity -= order.quantity;
+        rehash(slot);
+        order.quantity = new_quantity;
+        rehash(slot);
+        publish(order.side, LevelAction::Change, order.price, level);
         return true;
     }
 
-    // Get best bid price and order (highest buy price)
-    std::optional<std::reference_wrapper<Order>> get_best_bid() {
+    // Remove every resting order matching filter in one pass, calling
+    // on_cancel(const Order&) with each as it rested. With an account, only
+    // that account's order list is walked; without one, the levels in the
+    // price range. Levels are settled once at the end: each affected level
+    // gets a single L2 delta (Change, or Delete if emptied, then erased).
+    // Returns how many orders were removed.
+    template <typename F>
+    size_t mass_cancel(const MassCancelFilter& filter, F&& on_cancel) {
+        size_t removed = 0;
+        auto take = [&](PriceLevel& level, uint32_t slot) {
+            on_cancel(to_order(slot));
+            detach(level, slot);
+            removed++;
+        };
+        if (filter.account != 0) {
+            if (filter.account >= account_heads_.size()) return 0;
+            PriceLevel* level = nullptr;
+            bool have_level = false;
+            Side level_side = Side::Buy;
+            key_type level_key{};
+            for (uint32_t slot = account_heads_[filter.account]; slot != kNullSlot;) {
+                uint32_t next = pool_.meta(slot).account_next;
+                const Resting& resting = pool_[slot];
+                if (selects(filter, resting.side, resting.price)) {
+                    // An account's orders tend to cluster by level: skip the
+                    // lookup while they share one (nothing is erased yet)
+                    if (!have_level || resting.side != level_side || resting.price != level_key) {
+                        level_side = resting.side;
+                        level_key = resting.price;
+                        level = find_level(level_side, level_key);
+                        have_level = true;
+                        queue(level_side, level_key, *level);
+                    }
+                    take(*level, slot);
+                }
+                slot = next;
+            }
+        } else {
+            if (filter.side != Side::Sell) queue_range(bids_, Side::Buy, filter);
+            if (filter.side != Side::Buy) queue_range(asks_, Side::Sell, filter);
+            for (const auto& [side, key] : settle_) {
+                PriceLevel& level = *find_level(side, key);
+                while (!level.empty()) {
+                    take(level, level.head);
+                }
+            }
+        }
+        settle();
+        return removed;
+    }
+
+    // Pool slot of a resting order, or kNullSlot. The slot stays valid
+    // until the order leaves the book.
+    uint32_t find_slot(uint64_t order_id) const { return order_index_.find(order_id); }
+
+    // Packed record of the resting order in slot
+    const Resting& resting(uint32_t slot) const { return pool_[slot]; }
+    const OrderMeta& resting_meta(uint32_t slot) const { return pool_.meta(slot); }
+
+    // Re-price / re-size the resting order in slot without freeing its node.
+    // Less quantity at the same price keeps its queue position; more
+    // quantity or a new price moves it to the back of the level at key,
+    // stamped with timestamp. quantity is the total, so an iceberg keeps its
+    // display size. Returns false, leaving the order unchanged, if the store
+    // cannot hold key. The caller checks key does not cross.
+    bool amend(uint32_t slot, key_type key, uint32_t quantity,
+               std::chrono::steady_clock::time_point timestamp) {
+        if (pool_[slot].side == Side::Buy) {
+            return amend(bids_, slot, key, quantity, timestamp);
+        } else {
+            return amend(asks_, slot, key, quantity, timestamp);
+        }
+    }
+
+    // Remove the resting order in slot (as cancel_order, without the lookup)
+    void erase_slot(uint32_t slot) {
+        index_erase(pool_[slot].id);
+        if (pool_[slot].side == Side::Buy) {
+            remove(bids_, slot);
+        } else {
+            remove(asks_, slot);
+        }
+    }
+
+    // Look up a resting order by ID (rebuilt by value)
+    std::optional<Order> find_order(uint64_t order_id) const {
+        uint32_t slot = order_index_.find(order_id);
+        if (slot == kNullSlot) {
+            return std::nullopt;
+        }
+        return to_order(slot);
+    }
+
+    // Get best bid order (highest buy price, oldest first)
+    // Rebuilt from the packed resting record, so returned by value
+    std::optional<Order> get_best_bid() const {
         if (bids_.empty()) {
             return std::nullopt;
         }
-        return bids_.rbegin()->second.front();
+        return to_order(bids_.best().head);
     }
 
-    // Get best ask price and order (lowest sell price)
-    std::optional<std::reference_wrapper<Order>> get_best_ask() {
+    // Get best ask order (lowest sell price, oldest first)
+    std::optional<Order> get_best_ask() const {
         if (asks_.empty()) {
             return std::nullopt;
         }
-        return asks_.begin()->second.front();
+        return to_order(asks_.best().head);
     }
 
     // Check if book has bids
@@ -101,46 +311,627 @@ public:
     // Get best bid price
     std::optional<double> best_bid_price() const {
         if (bids_.empty()) return std::nullopt;
-        return bids_.rbegin()->first;
+        return bids_.to_price(bids_.best_key());
     }
 
     // Get best ask price
     std::optional<double> best_ask_price() const {
         if (asks_.empty()) return std::nullopt;
-        return asks_.begin()->first;
+        return asks_.to_price(asks_.best_key());
     }
 
-    // Get number of orders on each side
-    size_t bid_count() const {
-        size_t count = 0;
-        for (const auto& [price, queue] : bids_) {
-            count += queue.size();
+    // True if the price can be represented by this book's level store
+    bool on_grid(double price) const { return bids_.to_key(price).has_value(); }
+
+    // Price -> level key (nullopt if off the grid)
+    std::optional<key_type> to_key(double price) const { return bids_.to_key(price); }
+    double to_price(key_type key) const { return bids_.to_price(key); }
+
+    // f(key_type, const PriceLevel&) on each level of one side, best first,
+    // while it returns true
+    template <typename F>
+    void for_each_level(Side side, F&& f) const {
+        if (side == Side::Buy) {
+            bids_.for_each(f);
+        } else {
+            asks_.for_each(f);
         }
-        return count;
     }
 
-    size_t ask_count() const {
-        size_t count = 0;
-        for (const auto& [price, queue] : asks_) {
-            count += queue.size();
+    // Matching cursor over one side of the book, positioned on its best
+    // level. The engine walks the level's FIFO through front()/fill_front();
+    // filled orders are unlinked in place and an emptied level is erased and
+    // the cursor moved to the next best, with no re-lookup by ID or price.
+    template <Side S>
+    class Cursor {
+    public:
+        explicit Cursor(OrderBook& book) : book_(book), levels_(book.side<S>()) { load(); }
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+
+        // Publishes the one coalesced L2 change for a partially consumed level
+        ~Cursor() {
+            if (dirty_ && level_) {
+                book_.publish(S, LevelAction::Change, key_, *level_);
+            }
+        }
+
+        bool done() const { return level_ == nullptr; }
+        key_type key() const { return key_; }
+        double price() const { return levels_.to_price(key_); }
+        Resting& front() { return book_.pool_[level_->head]; }
+
+        // Front order's account (0 = none); touches the cold table only for
+        // orders that have one
+        uint32_t front_account() const {
+            uint32_t slot = level_->head;
+            return (book_.pool_[slot].flags & kOrderFlagAccount) ? book_.pool_.meta(slot).account : 0;
+        }
+
+        // Take qty from the front order; removes it once fully filled
+        void fill_front(uint32_t qty) {
+            Resting& resting = front();
+            book_.rehash(level_->head);
+            resting.quantity -= qty;
+            book_.rehash(level_->head);
+            level_->total_quantity -= qty;
+            book_.totals(S).quantity -= qty;
+            dirty_ = true;
+            if (resting.quantity == 0) {
+                if ((resting.flags & kOrderFlagIceberg) && book_.pool_.meta(level_->head).reserve > 0) {
+                    replenish();
+                } else {
+                    pop_front();
+                }
+            }
+        }
+
+        // Remove the front order regardless of its remaining quantity
+        void pop_front() {
+            Pool& pool = book_.pool_;
+            uint32_t slot = level_->head;
+            const Resting& resting = pool[slot];
+            book_.rehash(slot);
+            book_.index_erase(resting.id);
+            book_.note_removal(*level_, book_.totals(S), resting.quantity);
+            level_->head = pool[slot].next;
+            if (level_->head == kNullSlot) {
+                level_->tail = kNullSlot;
+            } else {
+                pool[level_->head].prev = kNullSlot;
+            }
+            book_.account_unlink(slot);
+            pool.release(slot);
+            dirty_ = true;
+            if (level_->empty()) {
+                book_.publish(S, LevelAction::Delete, key_, *level_);
+                levels_.erase_best();
+                dirty_ = false;
+                load();
+            }
+        }
+
+    private:
+        OrderBook& book_;
+        Levels<S>& levels_;
+
+        // Refill an iceberg's exhausted slice from its reserve and requeue
+        // the same node at the back of the level: no index or pool traffic.
+        // The new slice takes a new sequence, as it has lost priority.
+        void replenish() {
+            Pool& pool = book_.pool_;
+            uint32_t slot = level_->head;
+            OrderMeta& meta = pool.meta(slot);
+            uint32_t slice = std::min(meta.display, meta.reserve);
+            book_.rehash(slot);
+            meta.reserve -= slice;
+            meta.sequence = ++book_.sequence_;
+            pool[slot].quantity = slice;
+            book_.rehash(slot);
+            level_->total_quantity += slice;
+            book_.totals(S).quantity += slice;
+            if (level_->tail != slot) {
+                unlink(pool, *level_, slot);
+                push_back(pool, *level_, slot);
+            }
+        }
+        PriceLevel* level_ = nullptr;
+        key_type key_{};
+        bool dirty_ = false; // Current level changed since last published
+
+        void load() {
+            ORDERBOOK_PROBE(Stage::LevelLookup);
+            if (levels_.empty()) {
+                level_ = nullptr;
+            } else {
+                key_ = levels_.best_key();
+                level_ = &levels_.best();
+            }
+        }
+    };
+
+    template <Side S>
+    Cursor<S> cursor() { return Cursor<S>(*this); }
+
+    // Hand every L2 delta recorded since the last drain to f(const L2Delta&)
+    template <typename F>
+    void drain_deltas(F&& f) {
+        for (const L2Delta& delta : deltas_) {
+            f(delta);
         }
-        return count;
+        deltas_.clear(); // Keeps capacity: no allocation once warmed up
+    }
+
+    // Digest of every resting order (id, side, price, shown and hidden
+    // quantity, sequence), independent of memory layout and slot numbers:
+    // two books holding the same orders in the same queue positions hash
+    // equal. Kept in O(1) per change; 0 unless BookConfig::state_hash.
+    uint64_t state_hash() const { return state_hash_; }
+
+    // Sequence number of the last recorded delta. A snapshot taken now
+    // reflects every delta up to and including this one.
+    uint64_t l2_sequence() const { return l2_sequence_; }
+
+    // Copy up to depth best levels of one side into out; returns the count
+    size_t snapshot(Side side, size_t depth, L2Level* out) const {
+        return side == Side::Buy ? snapshot_side(bids_, depth, out)
+                                 : snapshot_side(asks_, depth, out);
+    }
+
+    // Get number of orders on each side
+    size_t bid_count() const { return bid_totals_.orders; }
+    size_t ask_count() const { return ask_totals_.orders; }
+
+    // Total resting quantity on each side
+    uint64_t bid_quantity() const { return bid_totals_.quantity; }
+    uint64_t ask_quantity() const { return ask_totals_.quantity; }
+
+    // Number of non-empty price levels on each side
+    size_t bid_levels() const { return bids_.level_count(); }
+    size_t ask_levels() const { return asks_.level_count(); }
+
+    // Resting quantity / order count at one price (0 if no such level).
+    // O(1) once the level is found: O(1) on the ladder, O(log n) on the map.
+    uint64_t level_quantity(Side side, double price) const {
+        auto key = bids_.to_key(price);
+        const PriceLevel* level = key ? find_level(side, *key) : nullptr;
+        return level ? level->total_quantity : 0;
+    }
+
+    uint32_t level_order_count(Side side, double price) const {
+        auto key = bids_.to_key(price);
+        const PriceLevel* level = key ? find_level(side, *key) : nullptr;
+        return level ? level->order_count : 0;
     }
 
+    // Node pool occupancy (capacity, in_use, high_water_mark)
+    const Pool& order_pool() const { return pool_; }
+
+    // Order-id index (hashed_size, capacity)
+    const OrderIndex& order_index() const { return order_index_; }
+
 private:
-    // Bids sorted by price (use map, iterate with rbegin for highest first)
-    std::map<double, OrderQueue> bids_;
-    
-    // Asks sorted by price (lowest first by default)
-    std::map<double, OrderQueue> asks_;
-
-    // For O(1) cancel: maps order_id -> location in the book
-    struct OrderLocation {
-        Side side;
-        double price;
-        OrderQueue::iterator iterator;
+    friend struct BookSnapshot<PriceLevels>; // Serializes the book (book_snapshot.hpp)
+
+    // Bids ordered highest price first
+    Levels<Side::Buy> bids_;
+
+    // Asks ordered lowest price first
+    Levels<Side::Sell> asks_;
+
+    // Storage for every resting order; levels link through it by slot
+    Pool pool_;
+
+    // For O(1) cancel: maps order_id -> pool slot. Side and price are read
+    // back from the node itself.
+    OrderIndex order_index_;
+
+    // Per-side aggregates, kept in step with the per-level ones
+    struct SideTotals {
+        size_t orders = 0;
+        uint64_t quantity = 0;
     };
-    std::unordered_map<uint64_t, OrderLocation> order_locations_;
+    SideTotals bid_totals_;
+    SideTotals ask_totals_;
+
+    SideTotals& totals(Side side) { return side == Side::Buy ? bid_totals_ : ask_totals_; }
+
+    // Per-account intrusive lists through OrderMeta::account_prev/next:
+    // head slot of each account's resting orders (index 0 unused)
+    ArenaVector<uint32_t> account_heads_;
+
+    // Mass cancel: levels affected so far, settled in one pass at the end
+    ArenaVector<std::pair<Side, key_type>> settle_;
+
+    // Last Order::sequence handed out; increases with every order rested
+    // or moved to the back of a level
+    uint64_t sequence_ = 0;
+
+    // Resting-order digest (off unless BookConfig::state_hash)
+    bool hash_state_;
+    uint64_t state_hash_ = 0;
+
+    // L2 delta recording (off unless BookConfig::publish_l2)
+    bool publish_l2_;
+    uint64_t l2_sequence_ = 0;
+    ArenaVector<L2Delta> deltas_;
+
+    void publish(Side side, LevelAction action, key_type key, const PriceLevel& level) {
+        if (!publish_l2_) return;
+        deltas_.push_back({++l2_sequence_, side, action, bids_.to_price(key),
+                           level.total_quantity, level.order_count});
+    }
+
+    // Sum levels best-first while within(key) until quantity is reached
+    template <typename Store, typename Within>
+    static bool available(const Store& levels, uint64_t quantity, Within within) {
+        uint64_t total = 0;
+        levels.for_each([&](key_type key, const PriceLevel& level) {
+            if (!within(key)) return false;
+            total += level.total_quantity;
+            return total < quantity;
+        });
+        return total >= quantity;
+    }
+
+    // The same, skipping or stopping at orders of account (see can_fill)
+    template <typename Store, typename Within>
+    bool available(const Store& levels, uint64_t quantity, Within within, uint32_t account,
+                   SelfTradePolicy stp) const {
+        uint64_t total = 0;
+        levels.for_each([&](key_type key, const PriceLevel& level) {
+            if (!within(key)) return false;
+            for (uint32_t slot = level.head; slot != kNullSlot && total < quantity; slot = pool_[slot].next) {
+                bool own = (pool_[slot].flags & kOrderFlagAccount) && pool_.meta(slot).account == account;
+                if (!own) {
+                    total += pool_[slot].quantity;
+                } else if (stp != SelfTradePolicy::CancelOldest) {
+                    return false;
+                }
+            }
+            return total < quantity;
+        });
+        return total >= quantity;
+    }
+
+    template <typename Store>
+    size_t snapshot_side(const Store& levels, size_t depth, L2Level* out) const {
+        size_t n = 0;
+        levels.for_each([&](key_type key, const PriceLevel& level) {
+            if (n == depth) return false;
+            out[n++] = {levels.to_price(key), level.total_quantity, level.order_count};
+            return true;
+        });
+        return n;
+    }
+
+    // Aggregate bookkeeping for an order leaving a level
+    static void note_removal(PriceLevel& level, SideTotals& side, uint32_t quantity) {
+        level.order_count--;
+        level.total_quantity -= quantity;
+        side.orders--;
+        side.quantity -= quantity;
+    }
+
+    const PriceLevel* find_level(Side side, key_type key) const {
+        return side == Side::Buy ? bids_.find(key) : asks_.find(key);
+    }
+    PriceLevel* find_level(Side side, key_type key) {
+        return const_cast<PriceLevel*>(std::as_const(*this).find_level(side, key));
+    }
+
+    Order to_order(uint32_t slot) const {
+        const Resting& resting = pool_[slot];
+        Order order;
+        order.id = resting.id;
+        order.type = OrderType::Limit;
+        order.side = resting.side;
+        order.price = bids_.to_price(resting.price);
+        order.quantity = resting.quantity;
+        order.timestamp = pool_.meta(slot).timestamp;
+        order.sequence = pool_.meta(slot).sequence;
+        order.account = pool_.meta(slot).account;
+        order.stp = pool_.meta(slot).stp;
+        order.post_only = (resting.flags & kOrderFlagPostOnly) != 0;
+        order.display_quantity = 0;
+        if (resting.flags & kOrderFlagIceberg) {
+            order.quantity += pool_.meta(slot).reserve;
+            order.display_quantity = pool_.meta(slot).display;
+        }
+        return order;
+    }
+
+    // Total quantity of the order in slot, reserve included
+    uint32_t total_quantity(uint32_t slot) const {
+        const Resting& resting = pool_[slot];
+        return (resting.flags & kOrderFlagIceberg) ? resting.quantity + pool_.meta(slot).reserve
+                                                   : resting.quantity;
+    }
+
+    // Split total into the displayed slice and (for an iceberg, display
+    // below total) a hidden reserve. Aggregates are the caller's job.
+    void set_quantity(uint32_t slot, uint32_t total, uint32_t display) {
+        Resting& resting = pool_[slot];
+        OrderMeta& meta = pool_.meta(slot);
+        if (display > 0 && display < total) {
+            resting.quantity = display;
+            resting.flags |= kOrderFlagIceberg;
+            meta.reserve = total - display;
+            meta.display = display;
+        } else {
+            resting.quantity = total;
+            resting.flags &= static_cast<uint8_t>(~kOrderFlagIceberg);
+            meta.reserve = 0;
+            meta.display = 0;
+        }
+    }
+
+    // XOR the order in slot into (or, called again, out of) the state
+    // digest: bracket every change to a hashed field with two calls
+    void rehash(uint32_t slot) {
+        if (!hash_state_) return;
+        const Resting& resting = pool_[slot];
+        const OrderMeta& meta = pool_.meta(slot);
+        uint64_t quantities = resting.quantity | (uint64_t(meta.reserve) << 32);
+        uint64_t h = hash_combine(hash_mix(resting.id), hash_bits(resting.price));
+        h = hash_combine(h, quantities);
+        h = hash_combine(h, meta.sequence ^ (uint64_t(resting.side) << 63));
+        state_hash_ ^= h;
+    }
+
+    // Thread / unthread the order in slot on its account's list (no-op for
+    // orders without one)
+    void account_link(uint32_t slot) {
+        if (!(pool_[slot].flags & kOrderFlagAccount)) return;
+        OrderMeta& meta = pool_.meta(slot);
+        uint32_t& head = account_heads_[meta.account];
+        meta.account_prev = kNullSlot;
+        meta.account_next = head;
+        if (head != kNullSlot) {
+            pool_.meta(head).account_prev = slot;
+        }
+        head = slot;
+    }
+
+    void account_unlink(uint32_t slot) {
+        if (!(pool_[slot].flags & kOrderFlagAccount)) return;
+        const OrderMeta& meta = pool_.meta(slot);
+        if (meta.account_prev == kNullSlot) {
+            account_heads_[meta.account] = meta.account_next;
+        } else {
+            pool_.meta(meta.account_prev).account_next = meta.account_next;
+        }
+        if (meta.account_next != kNullSlot) {
+            pool_.meta(meta.account_next).account_prev = meta.account_prev;
+        }
+    }
+
+    bool selects(const MassCancelFilter& filter, Side side, key_type key) const {
+        if (filter.side && *filter.side != side) return false;
+        double price = bids_.to_price(key);
+        return price >= filter.min_price && price <= filter.max_price;
+    }
+
+    // Mass cancel: list level for settling, once
+    void queue(Side side, key_type key, PriceLevel& level) {
+        if (!level.queued) {
+            level.queued = true;
+            settle_.emplace_back(side, key);
+        }
+    }
+
+    // Mass cancel: list every level of one side inside the filter's range
+    template <typename Store>
+    void queue_range(Store& levels, Side side, const MassCancelFilter& filter) {
+        levels.for_each([&](key_type key, const PriceLevel&) {
+            double price = levels.to_price(key);
+            // Best-first: bids run downwards, asks upwards
+            if (side == Side::Buy ? price < filter.min_price : price > filter.max_price) return false;
+            if (price >= filter.min_price && price <= filter.max_price) {
+                settle_.emplace_back(side, key);
+            }
+            return true;
+        });
+    }
+
+    // Unlink the order in slot from level, its index entry and its account
+    // and free the node; the level is left for settle()
+    void detach(PriceLevel& level, uint32_t slot) {
+        const Resting& resting = pool_[slot];
+        rehash(slot);
+        index_erase(resting.id);
+        account_unlink(slot);
+        unlink(pool_, level, slot);
+        note_removal(level, totals(resting.side), resting.quantity);
+        pool_.release(slot);
+    }
+
+    // One L2 delta per listed level; emptied levels erased. Keys, not
+    // pointers, are kept: an erase may relocate other levels.
+    void settle() {
+        for (const auto& [side, key] : settle_) {
+            if (side == Side::Buy) {
+                settle_level(bids_, side, key);
+            } else {
+                settle_level(asks_, side, key);
+            }
+        }
+        settle_.clear(); // Keeps capacity
+    }
+
+    template <typename Store>
+    void settle_level(Store& levels, Side side, key_type key) {
+        // emplace, not find: the level is still stored, but the ladder's
+        // find does not return empty levels
+        PriceLevel& level = *levels.emplace(key);
+        level.queued = false;
+        if (level.empty()) {
+            publish(side, LevelAction::Delete, key, level);
+            levels.erase(key);
+        } else {
+            publish(side, LevelAction::Change, key, level);
+        }
+    }
+
+    // Level find / emplace and index updates: the probe points
+    // (instrumentation.hpp) for those stages
+    template <typename Store>
+    static PriceLevel* find_level(Store& levels, key_type key) {
+        ORDERBOOK_PROBE(Stage::LevelLookup);
+        return levels.find(key);
+    }
+
+    template <typename Store>
+    static PriceLevel* emplace_level(Store& levels, key_type key) {
+        ORDERBOOK_PROBE(Stage::LevelLookup);
+        return levels.emplace(key);
+    }
+
+    bool index_insert(uint64_t order_id, uint32_t slot) {
+        ORDERBOOK_PROBE(Stage::IndexUpdate);
+        return order_index_.insert(order_id, slot);
+    }
+
+    uint32_t index_erase(uint64_t order_id) {
+        ORDERBOOK_PROBE(Stage::IndexUpdate);
+        return order_index_.erase(order_id);
+    }
+
+    template <Side S>
+    Levels<S>& side() {
+        if constexpr (S == Side::Buy) {
+            return bids_;
+        } else {
+            return asks_;
+        }
+    }
+
+    // Rest orders[0..n), which share side and price, at one level looked up
+    // once, stamping each with timestamp. Duplicate IDs are skipped.
+    // Returns how many were added.
+    template <typename Store>
+    size_t insert(Store& levels, const Order* orders, size_t n, key_type key,
+                  std::chrono::steady_clock::time_point timestamp) {
+        ORDERBOOK_PROBE(Stage::BookInsert);
+        PriceLevel* level = emplace_level(levels, key);
+        if (!level) {
+            return 0; // Outside the store's price range
+        }
+        bool was_empty = level->empty();
+        SideTotals& side = totals(orders[0].side);
+        size_t added = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (orders[i].account >= account_heads_.size()) {
+                continue; // Unknown account
+            }
+            uint32_t slot = pool_.allocate();
+            if (!index_insert(orders[i].id, slot)) {
+                pool_.release(slot);
+                continue; // Duplicate ID
+            }
+            Resting& resting = pool_[slot];
+            resting.id = orders[i].id;
+            resting.price = key;
+            resting.side = orders[i].side;
+            resting.flags = static_cast<uint8_t>((orders[i].account ? kOrderFlagAccount : 0) |
+                                                 (orders[i].post_only ? kOrderFlagPostOnly : 0));
+            pool_.meta(slot).timestamp = timestamp;
+            pool_.meta(slot).sequence = ++sequence_;
+            pool_.meta(slot).account = orders[i].account;
+            pool_.meta(slot).stp = orders[i].stp;
+            set_quantity(slot, orders[i].quantity, orders[i].display_quantity);
+            rehash(slot);
+            account_link(slot);
+            push_back(pool_, *level, slot);
+            level->order_count++;
+            level->total_quantity += resting.quantity;
+            side.orders++;
+            side.quantity += resting.quantity;
+            added++;
+        }
+        if (added == 0) {
+            if (was_empty) {
+                levels.erase(key);
+            }
+            return 0;
+        }
+        publish(orders[0].side, was_empty ? LevelAction::New : LevelAction::Change, key, *level);
+        return added;
+    }
+
+    template <typename Store>
+    bool amend(Store& levels, uint32_t slot, key_type key, uint32_t quantity,
+               std::chrono::steady_clock::time_point timestamp) {
+        Resting& order = pool_[slot];
+        SideTotals& side = totals(order.side);
+        key_type old_key = order.price;
+        PriceLevel* from = find_level(levels, old_key);
+        if (key == old_key && quantity <= total_quantity(slot)) {
+            rehash(slot);
+            // Reduce in place: queue position kept. An iceberg gives up
+            // reserve first and shrinks its shown slice only if it must.
+            uint32_t shown = std::min(order.quantity, quantity);
+            from->total_quantity -= order.quantity - shown;
+            side.quantity -= order.quantity - shown;
+            order.quantity = shown;
+            if (order.flags & kOrderFlagIceberg) {
+                pool_.meta(slot).reserve = quantity - shown;
+            }
+            rehash(slot);
+            publish(order.side, LevelAction::Change, key, *from);
+            return true;
+        }
+
+        PriceLevel* to = key == old_key ? from : emplace_level(levels, key);
+        if (!to) {
+            return false; // Outside the store's price range
+        }
+        bool was_empty = to->empty();
+        rehash(slot);
+        unlink(pool_, *from, slot);
+        note_removal(*from, side, order.quantity);
+        order.price = key;
+        set_quantity(slot, quantity, pool_.meta(slot).display);
+        pool_.meta(slot).timestamp = timestamp;
+        pool_.meta(slot).sequence = ++sequence_;
+        rehash(slot);
+        push_back(pool_, *to, slot);
+        to->order_count++;
+        to->total_quantity += order.quantity;
+        side.orders++;
+        side.quantity += order.quantity;
+
+        publish(order.side, was_empty ? LevelAction::New : LevelAction::Change, key, *to);
+        if (to != from) {
+            // The destination is non-empty, so the ladder's best rescan stops
+            if (from->empty()) {
+                publish(order.side, LevelAction::Delete, old_key, *from);
+                levels.erase(old_key);
+            } else {
+                publish(order.side, LevelAction::Change, old_key, *from);
+            }
+        }
+        return true;
+    }
+
+    template <typename Store>
+    void remove(Store& levels, uint32_t slot) {
+        const Resting& resting = pool_[slot];
+        key_type key = resting.price;
+        Side side = resting.side;
+        PriceLevel* level = find_level(levels, key);
+        rehash(slot);
+        unlink(pool_, *level, slot);
+        note_removal(*level, totals(side), resting.quantity);
+        account_unlink(slot);
+        pool_.release(slot);
+        if (level->empty()) {
+            publish(side, LevelAction::Delete, key, *level);
+            levels.erase(key);
+        } else {
+            publish(side, LevelAction::Change, key, *level);
+        }
+    }
 };
 
 } // namespace orderbook
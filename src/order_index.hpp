@@ -0,0 +1,195 @@
+#ifndef ORDER_INDEX_HPP
+#define ORDER_INDEX_HPP
+
+#include "order_pool.hpp"
+#include "arena.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace orderbook {
+
+// Maps order_id -> OrderPool slot.
+//
+// Main table: open addressing with Robin Hood linear probing over a
+// power-of-two array. Deletion shifts the following run back one place, so
+// there are no tombstones and probe lengths stay short under churn.
+//
+// Optional direct window: a ring indexed by (id & (window - 1)). Sequential
+// exchange-assigned IDs whose lifetime is shorter than the window always land
+// in an empty ring entry, so they are found with a single load and never
+// touch the hash table. An ID whose ring entry is taken falls back to the
+// hash table, so arbitrary IDs remain correct.
+class OrderIndex {
+public:
+    // expected_orders sizes the table (twice that, so half full at that
+    // count; it doubles past 7/8 load); direct_window is rounded up to a
+    // power of two, 0 disables the ring
+    explicit OrderIndex(size_t expected_orders, size_t direct_window = 0, Arena* arena = nullptr)
+        : table_(ArenaAllocator<Entry>(arena)), direct_(ArenaAllocator<Entry>(arena)) {
+        table_.resize(round_up_pow2(expected_orders * 2 < 16 ? 16 : expected_orders * 2));
+        shift_ = 64 - log2(table_.size());
+        if (direct_window > 0) {
+            direct_.resize(round_up_pow2(direct_window));
+        }
+    }
+
+    // Returns the slot for id, or kNullSlot
+    uint32_t find(uint64_t id) const {
+        if (!direct_.empty()) {
+            const Entry& e = direct_[id & (direct_.size() - 1)];
+            if (e.slot != kNullSlot && e.id == id) {
+                return e.slot;
+            }
+        }
+        if (hashed_ == 0) {
+            return kNullSlot;
+        }
+        size_t pos = find_pos(id);
+        return pos == kNotFound ? kNullSlot : table_[pos].slot;
+    }
+
+    // Insert id -> slot. Returns false if id is already present.
+    bool insert(uint64_t id, uint32_t slot) {
+        if (find(id) != kNullSlot) {
+            return false;
+        }
+        if (!direct_.empty()) {
+            Entry& e = direct_[id & (direct_.size() - 1)];
+            if (e.slot == kNullSlot) {
+                e = {id, slot, 0};
+                return true;
+            }
+        }
+        if ((hashed_ + 1) * 8 > table_.size() * 7) {
+            grow();
+        }
+        place({id, slot, 0});
+        hashed_++;
+        return true;
+    }
+
+    // Remove id. Returns its slot, or kNullSlot if not present.
+    uint32_t erase(uint64_t id) {
+        if (!direct_.empty()) {
+            Entry& e = direct_[id & (direct_.size() - 1)];
+            if (e.slot != kNullSlot && e.id == id) {
+                uint32_t slot = e.slot;
+                e.slot = kNullSlot;
+                return slot;
+            }
+        }
+        if (hashed_ == 0) {
+            return kNullSlot;
+        }
+        size_t pos = find_pos(id);
+        if (pos == kNotFound) {
+            return kNullSlot;
+        }
+        uint32_t slot = table_[pos].slot;
+        // Backward-shift deletion: pull the rest of the run one step closer
+        size_t mask = table_.size() - 1;
+        size_t next = (pos + 1) & mask;
+        while (table_[next].slot != kNullSlot && table_[next].dist > 0) {
+            table_[pos] = table_[next];
+            table_[pos].dist--;
+            pos = next;
+            next = (next + 1) & mask;
+        }
+        table_[pos].slot = kNullSlot;
+        hashed_--;
+        return slot;
+    }
+
+    // Pull the entries a lookup / insert of id would touch into cache
+    void prefetch(uint64_t id) const {
+        if (!direct_.empty()) {
+            __builtin_prefetch(&direct_[id & (direct_.size() - 1)]);
+        }
+        __builtin_prefetch(&table_[home(id)]);
+    }
+
+    // Entries currently held by the hash table (excludes the direct ring)
+    size_t hashed_size() const { return hashed_; }
+    size_t capacity() const { return table_.size(); }
+
+private:
+    struct Entry {
+        uint64_t id = 0;
+        uint32_t slot = kNullSlot; // kNullSlot marks an empty entry
+        uint32_t dist = 0;         // Distance from home bucket
+    };
+
+    static constexpr size_t kNotFound = SIZE_MAX;
+
+    ArenaVector<Entry> table_;
+    ArenaVector<Entry> direct_;
+    size_t hashed_ = 0;
+    unsigned shift_ = 0;
+
+    size_t home(uint64_t id) const {
+        // Fibonacci hashing: high bits of a multiplicative hash
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    size_t find_pos(uint64_t id) const {
+        size_t mask = table_.size() - 1;
+        size_t pos = home(id);
+        for (uint32_t dist = 0;; dist++, pos = (pos + 1) & mask) {
+            const Entry& e = table_[pos];
+            // Robin Hood invariant: id would have displaced any entry closer
+            // to its home than we are to ours
+            if (e.slot == kNullSlot || e.dist < dist) {
+                return kNotFound;
+            }
+            if (e.id == id) {
+                return pos;
+            }
+        }
+    }
+
+    void place(Entry entry) {
+        size_t mask = table_.size() - 1;
+        size_t pos = home(entry.id);
+        for (;; pos = (pos + 1) & mask) {
+            Entry& e = table_[pos];
+            if (e.slot == kNullSlot) {
+                e = entry;
+                return;
+            }
+            if (e.dist < entry.dist) {
+                std::swap(e, entry);
+            }
+            entry.dist++;
+        }
+    }
+
+    void grow() {
+        ArenaVector<Entry> old(table_.size() * 2, Entry(), table_.get_allocator());
+        old.swap(table_);
+        shift_--;
+        for (Entry& e : old) {
+            if (e.slot != kNullSlot) {
+                e.dist = 0;
+                place(e);
+            }
+        }
+    }
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static unsigned log2(size_t pow2) {
+        unsigned bits = 0;
+        while ((size_t{1} << bits) < pow2) bits++;
+        return bits;
+    }
+};
+
+} // namespace orderbook
+
+#endif // ORDER_INDEX_HPP
@@ -0,0 +1,186 @@
+#ifndef ORDER_POOL_HPP
+#define ORDER_POOL_HPP
+
+#include "order.hpp"
+#include "arena.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace orderbook {
+
+// Slot index meaning "no node" (end of list / empty level)
+constexpr uint32_t kNullSlot = UINT32_MAX;
+
+// Hot part of a resting order: everything matching and cancel read, packed
+// into 32 bytes so two records share a cache line. price is the level store's
+// native key (integer ticks on the ladder). prev/next are intrusive FIFO
+// links to neighbours at the same level, as pool slot indices.
+template <typename Key>
+struct alignas(32) RestingOrder {
+    uint64_t id;
+    Key price;
+    uint32_t quantity;
+    uint32_t prev;
+    uint32_t next;
+    Side side;
+    uint8_t flags; // kOrderFlag* bits
+};
+
+// RestingOrder::flags
+constexpr uint8_t kOrderFlagIceberg = 1; // Hidden reserve in OrderMeta
+constexpr uint8_t kOrderFlagAccount = 2; // OrderMeta::account is set
+constexpr uint8_t kOrderFlagPostOnly = 4; // A replace may not make it take liquidity
+
+static_assert(sizeof(RestingOrder<double>) == 32, "RestingOrder must stay 32 bytes");
+static_assert(sizeof(RestingOrder<int64_t>) == 32, "RestingOrder must stay 32 bytes");
+
+// Cold part of a resting order, in a table parallel to the hot records and
+// indexed by the same slot. The match loop reads it only for icebergs, when
+// a displayed slice runs out, and for orders flagged with an account.
+struct OrderMeta {
+    std::chrono::steady_clock::time_point timestamp;
+    uint64_t sequence; // Book-wide arrival order, independent of the clock
+    uint32_t reserve; // Iceberg: hidden quantity not yet displayed
+    uint32_t display; // Iceberg: size of each displayed slice
+    uint32_t account; // Owner (0 = none)
+    SelfTradePolicy stp; // Applied if a replace makes the order cross
+    uint32_t account_prev; // Owner's intrusive order list (see OrderBook::mass_cancel)
+    uint32_t account_next;
+};
+
+// Fixed-size slabs of RestingOrder (plus their OrderMeta) with an intrusive
+// free list. Capacity is preallocated at construction; when it runs out, one
+// more slab is added. Slabs never move, so references to nodes stay valid.
+// With an arena, slabs and the slab tables are carved from it.
+template <typename Key>
+class OrderPool {
+public:
+    using Node = RestingOrder<Key>;
+
+    static constexpr uint32_t kSlabShift = 12;
+    static constexpr uint32_t kSlabSize = 1u << kSlabShift; // Nodes per slab
+    static constexpr uint32_t kSlabMask = kSlabSize - 1;
+
+    explicit OrderPool(size_t initial_capacity, Arena* arena = nullptr)
+        : slabs_(ArenaAllocator<Slab<Node>>(arena)), meta_(ArenaAllocator<Slab<OrderMeta>>(arena)) {
+        size_t slabs = (initial_capacity + kSlabSize - 1) / kSlabSize;
+        slabs_.reserve(slabs);
+        meta_.reserve(slabs);
+        for (size_t i = 0; i < slabs; i++) {
+            add_slab();
+        }
+    }
+
+    // Take a node off the free list (grows by one slab if exhausted)
+    uint32_t allocate() {
+        if (free_head_ == kNullSlot) {
+            add_slab();
+        }
+        uint32_t slot = free_head_;
+        free_head_ = (*this)[slot].next;
+        if (++in_use_ > high_water_) {
+            high_water_ = in_use_;
+        }
+        return slot;
+    }
+
+    // Return a node to the free list
+    void release(uint32_t slot) {
+        (*this)[slot].next = free_head_;
+        free_head_ = slot;
+        --in_use_;
+    }
+
+    Node& operator[](uint32_t slot) {
+        return slabs_[slot >> kSlabShift][slot & kSlabMask];
+    }
+    const Node& operator[](uint32_t slot) const {
+        return slabs_[slot >> kSlabShift][slot & kSlabMask];
+    }
+
+    OrderMeta& meta(uint32_t slot) {
+        return meta_[slot >> kSlabShift][slot & kSlabMask];
+    }
+    const OrderMeta& meta(uint32_t slot) const {
+        return meta_[slot >> kSlabShift][slot & kSlabMask];
+    }
+
+    // Occupancy statistics
+    size_t capacity() const { return slabs_.size() * kSlabSize; }
+    size_t in_use() const { return in_use_; }
+    size_t high_water_mark() const { return high_water_; }
+
+private:
+    // One slab: a buffer that keeps its address when the table grows
+    template <typename T>
+    using Slab = ArenaVector<T>;
+
+    ArenaVector<Slab<Node>> slabs_;
+    ArenaVector<Slab<OrderMeta>> meta_;
+    uint32_t free_head_ = kNullSlot;
+    size_t in_use_ = 0;
+    size_t high_water_ = 0;
+
+    void add_slab() {
+        uint32_t first = static_cast<uint32_t>(slabs_.size()) << kSlabShift;
+        Arena* arena = slabs_.get_allocator().arena;
+        slabs_.emplace_back(kSlabSize, Node(), ArenaAllocator<Node>(arena));
+        meta_.emplace_back(kSlabSize, OrderMeta(), ArenaAllocator<OrderMeta>(arena));
+        // Chain the new slab in slot order so allocation walks memory forwards
+        Node* slab = slabs_.back().data();
+        for (uint32_t i = 0; i < kSlabSize; i++) {
+            slab[i].next = i + 1 < kSlabSize ? first + i + 1 : free_head_;
+        }
+        free_head_ = first;
+    }
+};
+
+// A price level: FIFO of orders threaded through OrderPool nodes, plus
+// aggregates maintained by OrderBook on every add/cancel/modify/fill
+struct PriceLevel {
+    uint32_t head = kNullSlot; // Oldest order (matched first)
+    uint32_t tail = kNullSlot; // Newest order
+    uint32_t order_count = 0;
+    bool queued = false; // Mass cancel: already listed for its one L2 delta (fits in padding)
+    uint64_t total_quantity = 0;
+
+    bool empty() const { return head == kNullSlot; }
+};
+
+static_assert(sizeof(PriceLevel) == 24, "PriceLevel must stay 24 bytes");
+
+// Append a node at the back of a level's queue
+template <typename Key>
+void push_back(OrderPool<Key>& pool, PriceLevel& level, uint32_t slot) {
+    RestingOrder<Key>& node = pool[slot];
+    node.prev = level.tail;
+    node.next = kNullSlot;
+    if (level.tail == kNullSlot) {
+        level.head = slot;
+    } else {
+        pool[level.tail].next = slot;
+    }
+    level.tail = slot;
+}
+
+// Remove a node from anywhere in a level's queue in O(1)
+template <typename Key>
+void unlink(OrderPool<Key>& pool, PriceLevel& level, uint32_t slot) {
+    RestingOrder<Key>& node = pool[slot];
+    if (node.prev == kNullSlot) {
+        level.head = node.next;
+    } else {
+        pool[node.prev].next = node.next;
+    }
+    if (node.next == kNullSlot) {
+        level.tail = node.prev;
+    } else {
+        pool[node.next].prev = node.prev;
+    }
+}
+
+} // namespace orderbook
+
+#endif // ORDER_POOL_HPP
@@ -0,0 +1,470 @@
+#ifndef PRICE_LEVELS_HPP
+#define PRICE_LEVELS_HPP
+
+#include "order.hpp"
+#include "book_config.hpp"
+#include "occupancy_bitmap.hpp"
+#include "arena.hpp"
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <optional>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace orderbook {
+
+// Price-level stores hold one side of the book: a set of Level objects keyed
+// by price, ordered best-first. OrderBook is templated on a policy whose
+// nested Store<Level, Side> picks the implementation at compile time.
+//
+// Every store provides:
+//   key_type                  native price key
+//   to_key(price)             price -> key, nullopt if not representable
+//   to_price(key)             key -> price
+//   empty(), level_count(), best_key(), best()
+//   find(key)                 existing level or nullptr (const and non-const)
+//   emplace(key)              existing or new level, nullptr if out of range;
+//                             other levels stay where they are
+//   erase(key)                drop a level that has just become empty; may
+//                             relocate other levels, so callers hold no level
+//                             pointers across it
+//   erase_best()              erase(best_key()) without a key lookup
+//   for_each(f)               visit (key, level) best-first while f returns true
+//   prefetch(key)             cache hint for a level (no-op if not addressable)
+
+// Red-black tree keyed on the raw double price. O(log n) per level access.
+template <typename Level, Side S>
+class MapLevelStore {
+public:
+    using key_type = double;
+
+    explicit MapLevelStore(const BookConfig& config) : levels_(Compare(), Allocator(config.arena)) {}
+
+    static std::optional<key_type> to_key(double price) { return price; }
+    static double to_price(key_type key) { return key; }
+
+    bool empty() const { return levels_.empty(); }
+    size_t level_count() const { return levels_.size(); }
+    key_type best_key() const { return levels_.begin()->first; }
+    Level& best() { return levels_.begin()->second; }
+    const Level& best() const { return levels_.begin()->second; }
+
+    Level* find(key_type key) {
+        auto it = levels_.find(key);
+        return it == levels_.end() ? nullptr : &it->second;
+    }
+    const Level* find(key_type key) const {
+        auto it = levels_.find(key);
+        return it == levels_.end() ? nullptr : &it->second;
+    }
+
+    Level* emplace(key_type key) { return &levels_[key]; }
+    void erase(key_type key) { levels_.erase(key); }
+    void erase_best() { levels_.erase(levels_.begin()); }
+
+    // Finding a tree node is the expensive part, so there is nothing to hint
+    void prefetch(key_type) const {}
+
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const auto& [key, level] : levels_) {
+            if (!f(key, level)) break;
+        }
+    }
+
+private:
+    // Best-first ordering: highest bid, lowest ask
+    using Compare = std::conditional_t<S == Side::Buy,
+                                       std::greater<double>, std::less<double>>;
+    using Allocator = ArenaAllocator<std::pair<const double, Level>>;
+    std::map<double, Level, Compare, Allocator> levels_;
+};
+
+namespace detail {
+
+// Price <-> integer tick conversion for the tick-based stores
+class TickGrid {
+public:
+    explicit TickGrid(double tick_size) : tick_size_(tick_size) {
+        // Converting through an integral ticks-per-unit keeps to_price() exact
+        // for the usual decimal tick sizes (0.01 -> divide by 100).
+        double per_unit = 1.0 / tick_size_;
+        if (std::abs(per_unit - std::round(per_unit)) < 1e-9) {
+            ticks_per_unit_ = std::round(per_unit);
+        }
+    }
+
+    // Rejects prices that are not a whole number of ticks
+    std::optional<int64_t> to_key(double price) const {
+        double ticks = ticks_per_unit_ > 0 ? price * ticks_per_unit_ : price / tick_size_;
+        double rounded = std::round(ticks);
+        if (std::abs(ticks - rounded) > 1e-6) {
+            return std::nullopt;
+        }
+        return static_cast<int64_t>(rounded);
+    }
+
+    double to_price(int64_t key) const {
+        return ticks_per_unit_ > 0 ? static_cast<double>(key) / ticks_per_unit_
+                                   : static_cast<double>(key) * tick_size_;
+    }
+
+    double tick_size() const { return tick_size_; }
+
+private:
+    double tick_size_;
+    double ticks_per_unit_ = 0; // 1 / tick_size when integral, else 0
+};
+
+} // namespace detail
+
+// Dense array of levels indexed by integer tick, centered on a reference
+// price. Best level is tracked as an index, so best_key()/best() are O(1) and
+// neighbouring levels share cache lines. An occupancy bitmap finds the next
+// best level when the touch empties, however sparse the book is behind it.
+template <typename Level, Side S>
+class TickLadderLevelStore {
+public:
+    using key_type = int64_t; // Absolute price in ticks
+
+    explicit TickLadderLevelStore(const BookConfig& config)
+        : grid_(config.tick_size), levels_(config.ladder_levels, Level(), ArenaAllocator<Level>(config.arena)),
+          occupancy_(config.ladder_levels, config.arena) {
+        base_ = std::llround(config.reference_price / config.tick_size)
+              - static_cast<int64_t>(levels_.size() / 2);
+    }
+
+    // Rejects prices that are not a whole number of ticks. Range is checked
+    // only when a level is created, so aggressive limits outside the ladder
+    // can still be compared against resting levels.
+    std::optional<key_type> to_key(double price) const { return grid_.to_key(price); }
+    double to_price(key_type key) const { return grid_.to_price(key); }
+
+    bool empty() const { return occupied_ == 0; }
+    size_t level_count() const { return occupied_; }
+    key_type best_key() const { return base_ + best_; }
+    Level& best() { return levels_[best_]; }
+    const Level& best() const { return levels_[best_]; }
+
+    Level* find(key_type key) {
+        return const_cast<Level*>(std::as_const(*this).find(key));
+    }
+    const Level* find(key_type key) const {
+        int64_t idx = key - base_;
+        if (!in_range(idx) || levels_[idx].empty()) {
+            return nullptr;
+        }
+        return &levels_[idx];
+    }
+
+    Level* emplace(key_type key) {
+        int64_t idx = key - base_;
+        if (!in_range(idx)) {
+            return nullptr;
+        }
+        if (!occupancy_.test(idx)) {
+            occupancy_.set(idx);
+            if (occupied_++ == 0 || better(idx, best_)) {
+                best_ = idx;
+            }
+        }
+        return &levels_[idx];
+    }
+
+    void erase(key_type key) {
+        int64_t idx = key - base_;
+        occupancy_.clear(idx);
+        if (--occupied_ == 0 || idx != best_) {
+            return;
+        }
+        // Best level emptied: the next one away from the touch
+        best_ = static_cast<int64_t>(next_from(idx));
+    }
+
+    void erase_best() { erase(base_ + best_); }
+
+    void prefetch(key_type key) const {
+        int64_t idx = key - base_;
+        if (in_range(idx)) {
+            __builtin_prefetch(&levels_[idx]);
+        }
+    }
+
+    template <typename F>
+    void for_each(F&& f) const {
+        if (occupied_ == 0) return;
+        for (size_t idx = best_; idx != OccupancyBitmap::npos; idx = next_from(static_cast<int64_t>(idx))) {
+            if (!f(base_ + static_cast<int64_t>(idx), levels_[idx])) break;
+        }
+    }
+
+private:
+    detail::TickGrid grid_;
+    int64_t base_;              // Tick of levels_[0]
+    int64_t best_ = 0;          // Index of best level, valid if occupied_ > 0
+    size_t occupied_ = 0;       // Non-empty levels
+    ArenaVector<Level> levels_;
+    OccupancyBitmap occupancy_; // Bit per level: set from emplace() to erase()
+
+    // Nearest occupied index strictly worse than idx, or npos
+    size_t next_from(int64_t idx) const {
+        if (S == Side::Buy) {
+            return idx == 0 ? OccupancyBitmap::npos : occupancy_.find_prev(static_cast<size_t>(idx - 1));
+        }
+        return occupancy_.find_next(static_cast<size_t>(idx + 1));
+    }
+
+    bool in_range(int64_t idx) const {
+        return idx >= 0 && idx < static_cast<int64_t>(levels_.size());
+    }
+
+    static bool better(int64_t a, int64_t b) {
+        return S == Side::Buy ? a > b : a < b;
+    }
+};
+
+// Dense window of window_levels ticks around the touch plus an ordered map
+// for every level outside it, so memory per book is bounded whatever the
+// price range, and the levels that see nearly all traffic are array slots.
+//
+// The window starts centered on reference_price and follows the market:
+// when an erase leaves the best level in the outer eighth of the window (or
+// outside it), the window is recentered on the best. Levels leaving move
+// into the map, levels entering move out of it, and those in both are
+// shifted in place. Only erase() moves levels; emplace() places a level
+// outside the window in the map and leaves everything else alone.
+template <typename Level, Side S>
+class HybridLevelStore {
+public:
+    using key_type = int64_t; // Absolute price in ticks
+
+    explicit HybridLevelStore(const BookConfig& config)
+        : grid_(config.tick_size),
+          window_(std::max<uint32_t>(config.window_levels, 8), Level(), ArenaAllocator<Level>(config.arena)),
+          occupancy_(window_.size(), config.arena), far_(Compare(), ArenaAllocator<std::pair<const int64_t, Level>>(config.arena)) {
+        lo_ = std::llround(config.reference_price / config.tick_size) - span() / 2;
+    }
+
+    // Prices must be a whole number of ticks; any such price can rest
+    std::optional<key_type> to_key(double price) const { return grid_.to_key(price); }
+    double to_price(key_type key) const { return grid_.to_price(key); }
+
+    bool empty() const { return count_ == 0; }
+    size_t level_count() const { return count_; }
+    key_type best_key() const { return best_key_; }
+    Level& best() { return *best_; }
+    const Level& best() const { return *best_; }
+
+    Level* find(key_type key) {
+        return const_cast<Level*>(std::as_const(*this).find(key));
+    }
+    const Level* find(key_type key) const {
+        int64_t idx = key - lo_;
+        if (in_window(idx)) {
+            return occupancy_.test(idx) ? &window_[idx] : nullptr;
+        }
+        auto it = far_.find(key);
+        return it == far_.end() ? nullptr : &it->second;
+    }
+
+    Level* emplace(key_type key) {
+        int64_t idx = key - lo_;
+        Level* level;
+        if (in_window(idx)) {
+            level = &window_[idx];
+            if (occupancy_.test(idx)) {
+                return level;
+            }
+            occupancy_.set(idx);
+        } else {
+            auto [it, inserted] = far_.try_emplace(key);
+            level = &it->second;
+            if (!inserted) {
+                return level;
+            }
+        }
+        if (count_++ == 0 || better(key, best_key_)) {
+            best_key_ = key;
+            best_ = level;
+        }
+        return level;
+    }
+
+    void erase(key_type key) {
+        int64_t idx = key - lo_;
+        if (in_window(idx)) {
+            occupancy_.clear(idx);
+            window_[idx] = Level{};
+        } else {
+            far_.erase(key);
+        }
+        if (--count_ == 0) {
+            return;
+        }
+        if (key == best_key_) {
+            find_best(key);
+        }
+        int64_t margin = span() / 8;
+        int64_t at = best_key_ - lo_;
+        if (at < margin || at >= span() - margin) {
+            recenter();
+        }
+    }
+
+    void erase_best() { erase(best_key_); }
+
+    void prefetch(key_type key) const {
+        int64_t idx = key - lo_;
+        if (in_window(idx)) {
+            __builtin_prefetch(&window_[idx]);
+        }
+    }
+
+    // Map levels better than the window, the window, then the rest of the map
+    template <typename F>
+    void for_each(F&& f) const {
+        auto it = far_.begin();
+        for (; it != far_.end() && better(it->first, window_best()); ++it) {
+            if (!f(it->first, it->second)) return;
+        }
+        for (size_t idx = first_in_window(); idx != OccupancyBitmap::npos; idx = next_in_window(idx)) {
+            if (!f(lo_ + static_cast<int64_t>(idx), window_[idx])) return;
+        }
+        for (; it != far_.end(); ++it) {
+            if (!f(it->first, it->second)) return;
+        }
+    }
+
+    // Lowest tick of the window (for tests and diagnostics)
+    key_type window_low() const { return lo_; }
+
+private:
+    using Compare = std::conditional_t<S == Side::Buy, std::greater<int64_t>, std::less<int64_t>>;
+
+    detail::TickGrid grid_;
+    ArenaVector<Level> window_;         // window_[i] is tick lo_ + i
+    OccupancyBitmap occupancy_;         // Occupied window slots
+    std::map<int64_t, Level, Compare, ArenaAllocator<std::pair<const int64_t, Level>>> far_; // Outside the window, best first
+    int64_t lo_;
+    key_type best_key_ = 0;             // Valid if count_ > 0
+    Level* best_ = nullptr;
+    size_t count_ = 0;                  // Window and map levels
+
+    int64_t span() const { return static_cast<int64_t>(window_.size()); }
+    bool in_window(int64_t idx) const { return idx >= 0 && idx < span(); }
+
+    static bool better(int64_t a, int64_t b) {
+        return S == Side::Buy ? a > b : a < b;
+    }
+
+    // Most extreme tick the window could hold on the best-price side
+    int64_t window_best() const { return S == Side::Buy ? lo_ + span() - 1 : lo_; }
+
+    size_t first_in_window() const {
+        return S == Side::Buy ? occupancy_.find_prev(window_.size() - 1) : occupancy_.find_next(0);
+    }
+
+    // Next occupied window slot past idx, away from the touch
+    size_t next_in_window(size_t idx) const {
+        if (S == Side::Buy) {
+            return idx == 0 ? OccupancyBitmap::npos : occupancy_.find_prev(idx - 1);
+        }
+        return occupancy_.find_next(idx + 1);
+    }
+
+    // New best after erasing the old one at key: the nearer of the next
+    // window level and the map's best (both are worse than key)
+    void find_best(key_type key) {
+        int64_t idx = key - lo_;
+        size_t next;
+        if (in_window(idx)) {
+            next = next_in_window(static_cast<size_t>(idx));
+        } else if (better(key, window_best())) {
+            next = first_in_window();
+        } else {
+            next = OccupancyBitmap::npos; // Past the window: only the map is left
+        }
+        if (next != OccupancyBitmap::npos) {
+            int64_t tick = lo_ + static_cast<int64_t>(next);
+            if (far_.empty() || better(tick, far_.begin()->first)) {
+                best_key_ = tick;
+                best_ = &window_[next];
+                return;
+            }
+        }
+        best_key_ = far_.begin()->first;
+        best_ = &far_.begin()->second;
+    }
+
+    // Move the window so the best level sits in its middle
+    void recenter() {
+        int64_t target = best_key_ - span() / 2;
+        int64_t shift = target - lo_;
+
+        // Levels falling out of the window go to the map
+        for (size_t idx = occupancy_.find_next(0); idx != OccupancyBitmap::npos;
+             idx = occupancy_.find_next(idx + 1)) {
+            int64_t moved = static_cast<int64_t>(idx) - shift;
+            if (!in_window(moved)) {
+                far_.emplace(lo_ + static_cast<int64_t>(idx), window_[idx]);
+                occupancy_.clear(idx);
+                window_[idx] = Level{};
+            }
+        }
+        // Shift the rest in place, walking so no slot is overwritten first
+        auto move = [&](size_t idx) {
+            size_t to = static_cast<size_t>(static_cast<int64_t>(idx) - shift);
+            window_[to] = window_[idx];
+            window_[idx] = Level{};
+            occupancy_.clear(idx);
+            occupancy_.set(to);
+        };
+        if (shift > 0) {
+            for (size_t idx = occupancy_.find_next(0); idx != OccupancyBitmap::npos;) {
+                size_t next = occupancy_.find_next(idx + 1);
+                move(idx);
+                idx = next;
+            }
+        } else if (shift < 0) {
+            for (size_t idx = occupancy_.find_prev(window_.size() - 1); idx != OccupancyBitmap::npos;) {
+                size_t next = idx == 0 ? OccupancyBitmap::npos : occupancy_.find_prev(idx - 1);
+                move(idx);
+                idx = next;
+            }
+        }
+        lo_ = target;
+
+        // Map levels now inside the window move into it: one contiguous run
+        auto it = S == Side::Buy ? far_.lower_bound(lo_ + span() - 1) : far_.lower_bound(lo_);
+        while (it != far_.end() && in_window(it->first - lo_)) {
+            size_t idx = static_cast<size_t>(it->first - lo_);
+            window_[idx] = it->second;
+            occupancy_.set(idx);
+            it = far_.erase(it);
+        }
+        best_ = &window_[best_key_ - lo_];
+    }
+};
+
+// Policies selecting a store for OrderBook / MatchingEngine
+struct MapPriceLevels {
+    template <typename Level, Side S>
+    using Store = MapLevelStore<Level, S>;
+};
+
+struct TickLadderPriceLevels {
+    template <typename Level, Side S>
+    using Store = TickLadderLevelStore<Level, S>;
+};
+
+struct HybridPriceLevels {
+    template <typename Level, Side S>
+    using Store = HybridLevelStore<Level, S>;
+};
+
+} // namespace orderbook
+
+#endif // PRICE_LEVELS_HPP
@@ -0,0 +1,286 @@
+#include "matching_engine.hpp"
+#include "binary_protocol.hpp"
+#include "journal.hpp"
+#include "latency_histogram.hpp"
+#include "tsc.hpp"
+#include "workload.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+using namespace orderbook;
+
+// Replay a recorded capture through MatchingEngine.
+//
+// Usage:
+//   replay_benchmark CAPTURE [--paced] [--speed X] [--tick T]
+//   replay_benchmark --generate CAPTURE [--ops N] [--depth N] [--rate R] [--seed S] [--mid P]
+//
+// A capture is a journal (journal.hpp) of wire messages (binary_protocol.hpp).
+// TimeMark messages carry the original arrival times: with --paced, the
+// messages after each mark are released at that time (scaled by --speed)
+// and latency runs from the release, so queueing is counted; messages
+// before the first mark (book setup) run back-to-back. Otherwise the whole
+// capture runs back-to-back. Each message is timed with the TSC into a
+// per-type histogram; throughput comes from a second, untimed replay. Every
+// level store is run on the same capture so results are comparable: the
+// tick ladder and the hybrid window are centered on the capture's own price
+// span (sized from a first pass over it), with --tick as the tick size, and
+// each store's rejects are reported so a mismatch shows.
+// --generate writes a synthetic capture (workload.hpp) for trying this out.
+struct Options {
+    const char* path = nullptr;
+    bool generate = false;
+    bool paced = false;
+    double speed = 1.0;
+    double tick_size = 0.01;
+    WorkloadConfig workload;
+};
+
+// What the sizing pass learns about a capture
+struct CaptureShape {
+    size_t orders = 1; // Adds / enters, plus one
+    double low = std::numeric_limits<double>::infinity();
+    double high = -std::numeric_limits<double>::infinity();
+
+    void price(double p) {
+        low = std::min(low, p);
+        high = std::max(high, p);
+    }
+};
+
+// Largest ladder the replay will allocate, in ticks
+constexpr uint32_t kMaxLadderLevels = 1u << 26;
+
+// Per-message-type slots for the histograms
+enum MessageSlot { kAdd, kExecute, kCancel, kReplace, kOther, kSlots };
+
+static MessageSlot slot_of(uint8_t type) {
+    switch (type) {
+    case wire::AddOrder: return kAdd;
+    case wire::EnterOrder: return kAdd;
+    case wire::ExecuteOrder: return kExecute;
+    case wire::CancelOrder: return kCancel;
+    case wire::ReplaceOrder: return kReplace;
+    default: return kOther;
+    }
+}
+
+struct CountingHandler {
+    uint64_t trades = 0;
+    uint64_t rejects = 0;
+    void on_trade(const Trade&) { trades++; }
+    void on_report(uint64_t, OrderStatus status, uint32_t, uint32_t) { rejects += status == OrderStatus::Rejected; }
+};
+
+// Books sized for every order in the capture, with the ladder and hybrid
+// window covering its prices
+static BookConfig config_for(const CaptureShape& shape, const Options& options) {
+    BookConfig config;
+    config.order_pool_capacity = shape.orders;
+    config.direct_index_window = shape.orders;
+    config.tick_size = options.tick_size;
+    if (shape.low <= shape.high) {
+        config.reference_price = std::round((shape.low + shape.high) / 2 / options.tick_size) * options.tick_size;
+        double span = std::ceil((shape.high - shape.low) / options.tick_size) + 3; // Both ends, and rounding
+        config.ladder_levels = static_cast<uint32_t>(
+            std::clamp<double>(span, config.ladder_levels, kMaxLadderLevels));
+    }
+    return config;
+}
+
+static void print_row(const std::string& name, const LatencyHistogram& h) {
+    std::cout << std::left << std::setw(12) << ("  " + name) << std::right << std::fixed
+              << std::setprecision(0) << std::setw(10) << h.count() << std::setw(8) << h.mean()
+              << std::setw(8) << h.percentile(0.50) << std::setw(8) << h.percentile(0.99)
+              << std::setw(9) << h.percentile(0.999) << std::setw(9) << h.percentile(0.9999)
+              << std::setw(10) << h.max() << std::endl;
+}
+
+static bool write_capture(const Options& options) {
+    Workload workload = generate_workload(options.workload);
+    JournalConfig config;
+    config.capacity = (workload.setup.size() + 2 * workload.events.size()) * 32 + 4096;
+    config.fsync = FsyncPolicy::None;
+    std::remove(options.path);
+    JournalWriter journal(options.path, config);
+    if (!journal.is_open()) return false;
+
+    uint8_t msg[64];
+    auto append = [&](const Command& command) {
+        const Order& o = command.order;
+        size_t n;
+        if (command.type == CommandType::Cancel) {
+            n = wire::encode_cancel_order(msg, o.id);
+        } else {
+            n = wire::encode_order(msg, o);
+        }
+        return journal.append(msg, n);
+    };
+    for (const Command& command : workload.setup) {
+        if (!append(command)) return false;
+    }
+    for (size_t i = 0; i < workload.events.size(); i++) {
+        size_t n = wire::encode_time_mark(msg, workload.arrival_ns[i]);
+        if (!journal.append(msg, n) || !append(workload.events[i])) return false;
+    }
+    std::cout << "Wrote " << journal.size() << " bytes (" << workload.setup.size() << " setup + "
+              << workload.events.size() << " timed events) to " << options.path << std::endl;
+    return journal.flush();
+}
+
+template <typename PriceLevels>
+void replay(const char* label, const MappedJournal& capture, const BookConfig& config,
+            const Options& options, const TscTimer& timer) {
+    LatencyHistogram all;
+    LatencyHistogram by_type[kSlots];
+    CountingHandler handler;
+    {
+        MatchingEngine<PriceLevels> engine(config);
+        const uint8_t* data = capture.data();
+        size_t size = capture.size();
+        bool anchored = false;
+        uint64_t origin = 0;
+        uint64_t release = 0;
+        for (size_t pos = 0; size - pos >= wire::kHeaderSize;) {
+            size_t frame = 2 + wire::load_le<uint16_t>(data + pos);
+            if (frame > size - pos) break;
+            uint8_t type = data[pos + 2];
+            if (type == wire::TimeMark) {
+                if (options.paced && frame >= wire::kHeaderSize + wire::kTimeMarkSize) {
+                    double ns = wire::TimeMarkView{data + pos + wire::kHeaderSize}.nanoseconds() / options.speed;
+                    uint64_t ticks = static_cast<uint64_t>(ns / timer.ns_per_tick);
+                    if (!anchored) {
+                        // First mark is "now": untimed setup before it doesn't delay the schedule
+                        origin = tsc_now() - ticks;
+                        anchored = true;
+                    }
+                    release = origin + ticks;
+                }
+                pos += frame;
+                continue;
+            }
+            uint64_t start;
+            if (anchored) {
+                while (tsc_now() < release) {
+                }
+                start = release;
+            } else {
+                start = tsc_now();
+            }
+            wire::decode(data + pos, frame, engine, handler);
+            uint64_t ns = timer.elapsed_ns(start, tsc_now());
+            all.record(ns);
+            by_type[slot_of(type)].record(ns);
+            pos += frame;
+        }
+    }
+
+    // Untimed pass for end-to-end throughput
+    double seconds;
+    {
+        MatchingEngine<PriceLevels> engine(config);
+        auto start = std::chrono::steady_clock::now();
+        capture.replay(engine);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << label << ": " << std::fixed << std::setprecision(2)
+              << all.count() / seconds / 1e6 << " M msgs/s, "
+              << capture.size() / seconds / (1 << 20) << " MiB/s, "
+              << handler.trades << " trades, " << handler.rejects << " rejects" << std::endl;
+    std::cout << std::left << std::setw(12) << "  message" << std::right << std::setw(10) << "count"
+              << std::setw(8) << "mean" << std::setw(8) << "p50" << std::setw(8) << "p99"
+              << std::setw(9) << "p99.9" << std::setw(9) << "p99.99" << std::setw(10) << "max"
+              << "   (ns)" << std::endl;
+    const char* names[kSlots] = {"add", "execute", "cancel", "replace", "other"};
+    for (int i = 0; i < kSlots; i++) {
+        if (by_type[i].count() > 0) print_row(names[i], by_type[i]);
+    }
+    print_row("all", all);
+    std::cout << std::endl;
+}
+
+static bool parse(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+        if (!std::strcmp(argv[i], "--generate")) options.generate = true;
+        else if (!std::strcmp(argv[i], "--paced")) options.paced = true;
+        else if (!std::strcmp(argv[i], "--speed")) options.speed = std::strtod(next(), nullptr);
+        else if (!std::strcmp(argv[i], "--tick")) options.tick_size = std::strtod(next(), nullptr);
+        else if (!std::strcmp(argv[i], "--ops")) options.workload.operations = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--depth")) options.workload.book_depth = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--rate")) options.workload.arrival_rate = std::strtod(next(), nullptr);
+        else if (!std::strcmp(argv[i], "--seed")) options.workload.seed = std::strtoull(next(), nullptr, 10);
+        else if (!std::strcmp(argv[i], "--mid")) options.workload.mid_price = std::strtod(next(), nullptr);
+        else if (argv[i][0] != '-' && !options.path) options.path = argv[i];
+        else return false;
+    }
+    return options.path != nullptr && options.speed > 0 && options.tick_size > 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " CAPTURE [--paced] [--speed X] [--tick T]\n"
+                  << "       " << argv[0] << " --generate CAPTURE [--ops N] [--depth N] [--rate R] [--seed S] [--mid P]"
+                  << std::endl;
+        return 1;
+    }
+    if (options.generate) {
+        return write_capture(options) ? 0 : 1;
+    }
+
+    MappedJournal capture(options.path);
+    if (!capture.is_open()) {
+        std::cerr << options.path << ": not a readable journal" << std::endl;
+        return 1;
+    }
+
+    // Size books for every order in the capture and find its price span
+    CaptureShape shape;
+    for (size_t pos = 0; capture.size() - pos >= wire::kHeaderSize;) {
+        size_t frame = 2 + wire::load_le<uint16_t>(capture.data() + pos);
+        if (frame > capture.size() - pos) break;
+        uint8_t type = capture.data()[pos + 2];
+        const uint8_t* body = capture.data() + pos + wire::kHeaderSize;
+        size_t body_size = frame - wire::kHeaderSize;
+        if (type == wire::AddOrder && body_size >= wire::kAddOrderSize) {
+            shape.orders++;
+            shape.price(wire::AddOrderView{body}.price());
+        } else if (type == wire::EnterOrder && body_size >= wire::kEnterOrderSize) {
+            shape.orders++;
+            Order order;
+            if (wire::EnterOrderView{body}.to_order(order) &&
+                (order.type == OrderType::Limit || order.type == OrderType::StopLimit)) {
+                shape.price(order.price);
+            }
+        } else if (type == wire::ReplaceOrder && body_size >= wire::kReplaceOrderSize) {
+            shape.price(wire::ReplaceOrderView{body}.price());
+        }
+        pos += frame;
+    }
+    BookConfig config = config_for(shape, options);
+
+    TscTimer timer = TscTimer::calibrate();
+    std::cout << "=== CAPTURE REPLAY BENCHMARK ===" << std::endl;
+    std::cout << options.path << ": " << capture.size() << " bytes, " << shape.orders - 1 << " adds, "
+              << (options.paced ? "paced" : "back-to-back");
+    if (options.paced) std::cout << " at " << options.speed << "x";
+    std::cout << std::endl;
+    if (shape.low <= shape.high) {
+        std::cout << "prices " << shape.low << " to " << shape.high << "; ladder of " << config.ladder_levels
+                  << " ticks of " << config.tick_size << " around " << config.reference_price << std::endl;
+    }
+    std::cout << std::endl;
+
+    replay<MapPriceLevels>("MapPriceLevels (std::map)", capture, config, options, timer);
+    replay<TickLadderPriceLevels>("TickLadderPriceLevels", capture, config, options, timer);
+    replay<HybridPriceLevels>("HybridPriceLevels (window + map)", capture, config, options, timer);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include "cpu.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace orderbook {
+
+// Bounded lock-free single-producer / single-consumer ring.
+// Head and tail live on separate cache lines, and each side keeps a cached
+// copy of the other's index so the shared line is only read when the ring
+// looks full (producer) or empty (consumer). N must be a power of two.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    // Producer side: false if the ring is full
+    bool try_push(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == N) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == N) {
+                return false;
+            }
+        }
+        slots_[tail & (N - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: false if the ring is empty
+    bool try_pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        out = slots_[head & (N - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: pop up to max values into out with a single acquire of
+    // the tail and a single release of the head. Returns the number popped.
+    size_t pop_batch(T* out, size_t max) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (tail_cache_ - head < max) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+        }
+        size_t n = tail_cache_ - head;
+        if (n > max) n = max;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = slots_[(head + i) & (N - 1)];
+        }
+        if (n > 0) {
+            head_.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Approximate when called concurrently with the other side
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    // Consumer-owned line
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+
+    // Producer-owned line
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+
+    alignas(kCacheLine) std::array<T, N> slots_;
+};
+
+} // namespace orderbook
+
+#endif // SPSC_RING_HPP
@@ -0,0 +1,37 @@
+#ifndef STATE_HASH_HPP
+#define STATE_HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace orderbook {
+
+// 64-bit mixing for state digests (the splitmix64 finalizer): every input
+// bit affects every output bit, so XOR-ing one mixed hash per element gives
+// an order-independent set digest that can be updated in O(1) by XOR-ing an
+// element's old hash out and its new one in.
+inline uint64_t hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value) {
+    return hash_mix(seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2)));
+}
+
+// Bits of an integer or double price key
+template <typename T>
+uint64_t hash_bits(T value) {
+    static_assert(sizeof(T) == 8, "64-bit keys only");
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace orderbook
+
+#endif // STATE_HASH_HPP
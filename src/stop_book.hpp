@@ -0,0 +1,235 @@
+#ifndef STOP_BOOK_HPP
+#define STOP_BOOK_HPP
+
+#include "order.hpp"
+#include "order_index.hpp"
+#include "arena.hpp"
+#include "state_hash.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace orderbook {
+
+// Pending stop / stop-limit orders, kept apart from the matching book and
+// ordered by stop price.
+//
+// A buy stop triggers once the last trade is at or above its stop price, a
+// sell stop once it is at or below. The nearest stop price on each side is
+// cached, so checking a trade price against every pending stop is two
+// compares. Triggered orders come out nearest stop first, FIFO among equal
+// stop prices, buys before sells.
+class StopBook {
+public:
+    explicit StopBook(size_t expected = 64, Arena* arena = nullptr)
+        : buys_(std::less<double>(), ArenaAllocator<std::pair<const double, Queue>>(arena)),
+          sells_(std::greater<double>(), ArenaAllocator<std::pair<const double, Queue>>(arena)),
+          orders_(ArenaAllocator<Order>(arena)), free_(ArenaAllocator<uint32_t>(arena)),
+          index_(expected, 0, arena) {}
+
+    // Park a Stop / StopLimit order, giving it the next Order::sequence.
+    // Returns false if its ID is pending.
+    bool add(const Order& order) {
+        Order parked = order;
+        parked.sequence = sequence_ + 1;
+        if (!restore(parked)) return false;
+        sequence_++;
+        return true;
+    }
+
+    // Park a stop keeping its Order::sequence (snapshot restore; queue
+    // order is the call order, as for add)
+    bool restore(const Order& order) {
+        uint32_t slot;
+        if (free_.empty()) {
+            slot = static_cast<uint32_t>(orders_.size());
+            orders_.push_back(order);
+        } else {
+            slot = free_.back();
+            free_.pop_back();
+            orders_[slot] = order;
+        }
+        if (!index_.insert(order.id, slot)) {
+            free_.push_back(slot);
+            return false;
+        }
+        state_hash_ ^= hash(order);
+        if (order.side == Side::Buy) {
+            enqueue(buys_, order.stop_price, slot);
+        } else {
+            enqueue(sells_, order.stop_price, slot);
+        }
+        sequence_ = std::max(sequence_, order.sequence);
+        update_triggers();
+        return true;
+    }
+
+    // Remove a pending stop. Returns false if id is not pending.
+    bool cancel(uint64_t id) {
+        uint32_t slot = index_.erase(id);
+        if (slot == kNullSlot) {
+            return false;
+        }
+        const Order& order = orders_[slot];
+        state_hash_ ^= hash(order);
+        if (order.side == Side::Buy) {
+            drop(buys_, order.stop_price, slot);
+        } else {
+            drop(sells_, order.stop_price, slot);
+        }
+        free_.push_back(slot);
+        update_triggers();
+        return true;
+    }
+
+    // Remove every pending stop for which pred(const Order&) holds, passing
+    // each to on_cancel(const Order&) first. Returns how many were removed.
+    template <typename Pred, typename F>
+    size_t cancel_if(Pred&& pred, F&& on_cancel) {
+        size_t removed = sweep(buys_, pred, on_cancel) + sweep(sells_, pred, on_cancel);
+        if (removed > 0) {
+            update_triggers();
+        }
+        return removed;
+    }
+
+    bool contains(uint64_t id) const { return index_.find(id) != kNullSlot; }
+
+    // O(1): does a trade at last trigger any pending stop?
+    bool triggered(double last) const {
+        return last >= buy_trigger_ || last <= sell_trigger_;
+    }
+
+    // Remove and return the next stop triggered at last (triggered(last)
+    // must hold)
+    Order pop_triggered(double last) {
+        uint32_t slot = last >= buy_trigger_ ? pop_front(buys_) : pop_front(sells_);
+        Order order = orders_[slot];
+        state_hash_ ^= hash(order);
+        index_.erase(order.id);
+        free_.push_back(slot);
+        update_triggers();
+        return order;
+    }
+
+    size_t size() const { return orders_.size() - free_.size(); }
+
+    // Visit each pending stop in trigger order (buys, then sells; FIFO per
+    // stop price), so add() in the same order rebuilds the same queues
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const auto& [stop_price, queue] : buys_) {
+            for (uint32_t slot : queue) f(orders_[slot]);
+        }
+        for (const auto& [stop_price, queue] : sells_) {
+            for (uint32_t slot : queue) f(orders_[slot]);
+        }
+    }
+
+    // Digest of the pending stops: like OrderBook::state_hash, each entry's
+    // sequence stands for its queue position
+    uint64_t state_hash() const { return state_hash_; }
+
+    // Last Order::sequence handed out (the stop holding it may be gone)
+    uint64_t sequence() const { return sequence_; }
+    void restore_sequence(uint64_t sequence) { sequence_ = std::max(sequence_, sequence); }
+    bool empty() const { return size() == 0; }
+
+private:
+    // Stop price -> FIFO of slots; each side nearest-to-trigger first
+    using Queue = std::deque<uint32_t, ArenaAllocator<uint32_t>>;
+    template <typename Compare>
+    using Levels = std::map<double, Queue, Compare, ArenaAllocator<std::pair<const double, Queue>>>;
+
+    Levels<std::less<double>> buys_;     // Lowest stop triggers first
+    Levels<std::greater<double>> sells_; // Highest stop triggers first
+    ArenaVector<Order> orders_;
+    ArenaVector<uint32_t> free_;
+    OrderIndex index_;
+    uint64_t state_hash_ = 0;
+    uint64_t sequence_ = 0;
+    double buy_trigger_ = std::numeric_limits<double>::infinity();
+    double sell_trigger_ = -std::numeric_limits<double>::infinity();
+
+    static uint64_t hash(const Order& order) {
+        uint64_t h = hash_combine(hash_mix(order.id), hash_bits(order.stop_price));
+        h = hash_combine(h, hash_bits(order.price));
+        h = hash_combine(h, order.quantity | (uint64_t(order.account) << 32));
+        h = hash_combine(h, order.display_quantity | (uint64_t(order.stp) << 32));
+        h = hash_combine(h, order.sequence);
+        return hash_combine(h, static_cast<uint64_t>(order.side) | static_cast<uint64_t>(order.type) << 8 |
+                                   static_cast<uint64_t>(order.tif) << 16 | uint64_t(order.post_only) << 24);
+    }
+
+    void update_triggers() {
+        buy_trigger_ = buys_.empty() ? std::numeric_limits<double>::infinity() : buys_.begin()->first;
+        sell_trigger_ = sells_.empty() ? -std::numeric_limits<double>::infinity() : sells_.begin()->first;
+    }
+
+    // A new queue takes the map's allocator (operator[] would not)
+    template <typename L>
+    static void enqueue(L& levels, double stop_price, uint32_t slot) {
+        auto it = levels.find(stop_price);
+        if (it == levels.end()) {
+            it = levels.emplace(stop_price, Queue(ArenaAllocator<uint32_t>(levels.get_allocator()))).first;
+        }
+        it->second.push_back(slot);
+    }
+
+    template <typename L>
+    static uint32_t pop_front(L& levels) {
+        auto it = levels.begin();
+        uint32_t slot = it->second.front();
+        it->second.pop_front();
+        if (it->second.empty()) {
+            levels.erase(it);
+        }
+        return slot;
+    }
+
+    template <typename L, typename Pred, typename F>
+    size_t sweep(L& levels, Pred& pred, F& on_cancel) {
+        size_t removed = 0;
+        for (auto it = levels.begin(); it != levels.end();) {
+            auto& queue = it->second;
+            auto kept = std::remove_if(queue.begin(), queue.end(), [&](uint32_t slot) {
+                const Order& order = orders_[slot];
+                if (!pred(order)) return false;
+                on_cancel(order);
+                state_hash_ ^= hash(order);
+                index_.erase(order.id);
+                free_.push_back(slot);
+                removed++;
+                return true;
+            });
+            queue.erase(kept, queue.end());
+            it = queue.empty() ? levels.erase(it) : std::next(it);
+        }
+        return removed;
+    }
+
+    template <typename L>
+    static void drop(L& levels, double stop_price, uint32_t slot) {
+        auto it = levels.find(stop_price);
+        auto& queue = it->second;
+        for (auto q = queue.begin(); q != queue.end(); ++q) {
+            if (*q == slot) {
+                queue.erase(q);
+                break;
+            }
+        }
+        if (queue.empty()) {
+            levels.erase(it);
+        }
+    }
+};
+
+} // namespace orderbook
+
+#endif // STOP_BOOK_HPP
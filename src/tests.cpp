@@ -1,6 +1,21 @@
 #include "matching_engine.hpp"
+#include "multi_symbol_engine.hpp"
+#include "engine_pipeline.hpp"
+#include "binary_protocol.hpp"
+#include "journal.hpp"
+#include "latency_histogram.hpp"
+#include "workload.hpp"
+#include "instrumentation.hpp"
+#include <thread>
 #include <iostream>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <algorithm>
 
 using namespace orderbook;
 
@@ -129,6 +144,2050 @@ void test_market_order_empty_book() {
     std::cout << "TEST 5 PASSED: Market order on empty book handles gracefully" << std::endl;
 }
 
+// TEST 6: Tick ladder book → same matching semantics as the map book
+void test_tick_ladder_matching() {
+    MatchingEngine<TickLadderPriceLevels> engine;
+
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.00, 5));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.01, 5));
+    engine.process_order(make_order(3, OrderType::Limit, Side::Sell, 100.05, 5));
+    engine.process_order(make_order(4, OrderType::Limit, Side::Buy, 99.99, 5));
+    assert(engine.best_ask() == 100.00);
+    assert(engine.best_bid() == 99.99);
+
+    // Limit buy at 100.01 for 12: takes 100.00 and 100.01, rests 2 at 100.01
+    auto trades = engine.process_order(make_order(5, OrderType::Limit, Side::Buy, 100.01, 12));
+    assert(trades.size() == 2);
+    assert(trades[0].price == 100.00);
+    assert(trades[1].price == 100.01);
+    assert(engine.best_bid() == 100.01);
+    assert(engine.best_ask() == 100.05); // Best index skipped the empty ticks
+
+    // Cancelling the touch falls back to the next populated tick
+    assert(engine.cancel_order(5));
+    assert(engine.best_bid() == 99.99);
+
+    std::cout << "TEST 6 PASSED: Tick ladder matches with price-time priority" << std::endl;
+}
+
+// TEST 7: Tick ladder rejects prices it cannot represent
+void test_tick_ladder_rejects_bad_prices() {
+    BookConfig config;
+    config.tick_size = 0.05;
+    config.reference_price = 100.0;
+    config.ladder_levels = 100; // Covers 97.50 .. 102.45
+    MatchingEngine<TickLadderPriceLevels> engine(config);
+
+    engine.process_order(make_order(1, OrderType::Limit, Side::Buy, 100.03, 10)); // Off grid
+    engine.process_order(make_order(2, OrderType::Limit, Side::Buy, 90.00, 10));  // Out of range
+    assert(!engine.has_bids());
+
+    engine.process_order(make_order(3, OrderType::Limit, Side::Sell, 102.45, 10));
+    assert(engine.best_ask() == 102.45);
+
+    // Aggressive limit beyond the ladder still crosses
+    auto trades = engine.process_order(make_order(4, OrderType::Limit, Side::Buy, 150.00, 4));
+    assert(trades.size() == 1);
+    assert(trades[0].price == 102.45);
+    assert(engine.book().ask_count() == 1);
+
+    std::cout << "TEST 7 PASSED: Tick ladder rejects off-grid and out-of-range prices" << std::endl;
+}
+
+// TEST 8: Order pool → nodes reused after cancel, grows in slabs, tracks high water
+void test_order_pool_occupancy() {
+    BookConfig config;
+    config.order_pool_capacity = OrderPool<double>::kSlabSize;
+    OrderBook<> book(config);
+
+    for (uint64_t id = 1; id <= 3; id++) {
+        book.add_order(make_order(id, OrderType::Limit, Side::Buy, 100.0, 10));
+    }
+    assert(book.order_pool().in_use() == 3);
+    assert(book.order_pool().high_water_mark() == 3);
+
+    // FIFO survives a cancel from the middle of the queue
+    assert(book.cancel_order(2));
+    assert(book.get_best_bid()->id == 1);
+    assert(book.cancel_order(1));
+    assert(book.get_best_bid()->id == 3);
+    assert(book.order_pool().in_use() == 1);
+    assert(book.order_pool().high_water_mark() == 3);
+
+    // Exhausting the preallocated slab adds exactly one more
+    for (uint64_t id = 10; id < 10 + OrderPool<double>::kSlabSize; id++) {
+        book.add_order(make_order(id, OrderType::Limit, Side::Sell, 101.0, 1));
+    }
+    assert(book.order_pool().capacity() == 2 * OrderPool<double>::kSlabSize);
+    assert(book.ask_count() == OrderPool<double>::kSlabSize);
+
+    std::cout << "TEST 8 PASSED: Order pool tracks occupancy and grows by slab" << std::endl;
+}
+
+// TEST 9: Order index → Robin Hood table and direct ring agree under churn
+void test_order_index() {
+    OrderIndex index(16, 64);
+
+    // Sequential IDs live in the direct ring, never the hash table
+    for (uint32_t id = 1; id <= 50; id++) {
+        assert(index.insert(id, id * 10));
+    }
+    assert(index.hashed_size() == 0);
+    assert(!index.insert(7, 0)); // Duplicate rejected
+
+    // ID 65 collides with 1 in the ring and falls back to the table
+    assert(index.insert(65, 650));
+    assert(index.hashed_size() == 1);
+    assert(index.find(65) == 650);
+    assert(index.find(1) == 10);
+
+    // Sparse IDs force growth and long runs; erase every other one
+    for (uint64_t i = 0; i < 1000; i++) {
+        assert(index.insert(1'000'000 + i * 7919, static_cast<uint32_t>(i)));
+    }
+    for (uint64_t i = 0; i < 1000; i += 2) {
+        assert(index.erase(1'000'000 + i * 7919) == i);
+    }
+    for (uint64_t i = 0; i < 1000; i++) {
+        uint32_t expected = i % 2 ? static_cast<uint32_t>(i) : kNullSlot;
+        assert(index.find(1'000'000 + i * 7919) == expected);
+    }
+    assert(index.capacity() >= 1024);
+    assert(index.erase(65) == 650);
+    assert(index.erase(65) == kNullSlot);
+
+    // Book wired with a direct window behaves the same
+    BookConfig config;
+    config.direct_index_window = 1024;
+    MatchingEngine<> engine(config);
+    engine.process_order(make_order(1, OrderType::Limit, Side::Buy, 100.0, 10));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Buy, 100.0, 10));
+    assert(engine.cancel_order(1));
+    assert(!engine.cancel_order(1));
+    assert(engine.book().order_index().hashed_size() == 0);
+
+    std::cout << "TEST 9 PASSED: Open-addressing order index handles churn" << std::endl;
+}
+
+// TEST 10: Trade sinks → fills stream into caller storage, vector API unchanged
+void test_trade_sinks() {
+    MatchingEngine engine;
+    for (uint64_t id = 1; id <= 4; id++) {
+        engine.process_order(make_order(id, OrderType::Limit, Side::Sell, 100.0 + id, 5));
+    }
+
+    // Preallocated span: 3 slots for a 4-level sweep
+    Trade storage[3];
+    TradeSpanSink span(storage, 3);
+    engine.process_order(make_order(10, OrderType::Market, Side::Buy, 0.0, 20), span);
+    assert(span.count == 3);
+    assert(span.dropped == 1);
+    assert(storage[0].sell_order_id == 1);
+    assert(storage[2].price == 103.0);
+    assert(!engine.has_asks());
+
+    // Ring buffer drained in FIFO order
+    engine.process_order(make_order(11, OrderType::Limit, Side::Buy, 99.0, 5));
+    engine.process_order(make_order(12, OrderType::Limit, Side::Buy, 98.0, 5));
+    TradeRing<4> ring;
+    engine.process_order(make_order(13, OrderType::Limit, Side::Sell, 98.0, 8), ring);
+    Trade t;
+    assert(ring.pop(t) && t.buy_order_id == 11 && t.quantity == 5);
+    assert(ring.pop(t) && t.buy_order_id == 12 && t.quantity == 3);
+    assert(!ring.pop(t));
+
+    // Any callable works
+    uint32_t filled = 0;
+    engine.process_order(make_order(14, OrderType::Market, Side::Sell, 0.0, 1),
+                         [&](const Trade& trade) { filled += trade.quantity; });
+    assert(filled == 1);
+
+    std::cout << "TEST 10 PASSED: Trade sinks receive fills without a vector" << std::endl;
+}
+
+// TEST 11: Sweep through 20 levels → FIFO per level, filled orders fully removed
+void test_multi_level_sweep() {
+    MatchingEngine<TickLadderPriceLevels> engine;
+    uint64_t id = 1;
+    for (int level = 0; level < 20; level++) {
+        for (int i = 0; i < 2; i++) {
+            engine.process_order(make_order(id++, OrderType::Limit, Side::Buy, 100.00 - level * 0.01, 5));
+        }
+    }
+    assert(engine.book().order_pool().in_use() == 40);
+
+    // Sell limit down to 99.85 takes levels 100.00..99.85 (16 levels, 32 orders)
+    // and rests the remainder at its limit
+    auto trades = engine.process_order(make_order(100, OrderType::Limit, Side::Sell, 99.85, 165));
+    assert(trades.size() == 32);
+    for (size_t i = 0; i < trades.size(); i++) {
+        assert(trades[i].buy_order_id == i + 1); // Price then time priority
+    }
+    assert(engine.best_bid() == 99.84);
+    assert(engine.best_ask() == 99.85);
+    assert(engine.book().order_pool().in_use() == 9); // 8 bids + resting sell
+    assert(!engine.cancel_order(1));                  // Filled orders left the index
+    assert(engine.cancel_order(33));
+
+    std::cout << "TEST 11 PASSED: Multi-level sweep removes filled orders in place" << std::endl;
+}
+
+// TEST 12: Level and side aggregates → kept exact through add/cancel/modify/fill
+void test_level_aggregates() {
+    MatchingEngine engine;
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 101.0, 10));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 101.0, 20));
+    engine.process_order(make_order(3, OrderType::Limit, Side::Sell, 102.0, 30));
+    engine.process_order(make_order(4, OrderType::Limit, Side::Buy, 99.0, 40));
+
+    const auto& book = engine.book();
+    assert(book.ask_count() == 3 && book.ask_quantity() == 60 && book.ask_levels() == 2);
+    assert(book.bid_count() == 1 && book.bid_quantity() == 40 && book.bid_levels() == 1);
+    assert(book.level_quantity(Side::Sell, 101.0) == 30);
+    assert(book.level_order_count(Side::Sell, 101.0) == 2);
+    assert(book.level_quantity(Side::Sell, 100.0) == 0);
+
+    // Partial fill of the front order at 101
+    engine.process_order(make_order(5, OrderType::Limit, Side::Buy, 101.0, 4));
+    assert(book.level_quantity(Side::Sell, 101.0) == 26);
+    assert(book.level_order_count(Side::Sell, 101.0) == 2);
+    assert(book.ask_quantity() == 56);
+
+    // Cancel the second order at 101
+    engine.cancel_order(2);
+    assert(book.level_quantity(Side::Sell, 101.0) == 6);
+    assert(book.ask_count() == 2);
+
+    // Sweep empties 101 and takes 4 from 102
+    engine.process_order(make_order(6, OrderType::Market, Side::Buy, 0.0, 10));
+    assert(book.ask_levels() == 1);
+    assert(book.level_quantity(Side::Sell, 102.0) == 26);
+    assert(book.ask_count() == 1 && book.ask_quantity() == 26);
+
+    // Direct quantity amendment
+    OrderBook<> standalone;
+    standalone.add_order(make_order(7, OrderType::Limit, Side::Buy, 50.0, 8));
+    standalone.modify_quantity(7, 3);
+    assert(standalone.level_quantity(Side::Buy, 50.0) == 3);
+    assert(standalone.bid_quantity() == 3);
+
+    std::cout << "TEST 12 PASSED: Level and side aggregates stay consistent" << std::endl;
+}
+
+// TEST 13: L2 deltas → replayed on a snapshot they reproduce the book
+void test_l2_deltas() {
+    BookConfig config;
+    config.publish_l2 = true;
+    MatchingEngine engine(config);
+
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 101.0, 10));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 101.0, 5));
+
+    // Late joiner: snapshot now, apply only deltas after its sequence
+    L2Level levels[8];
+    size_t n = engine.snapshot(Side::Sell, 8, levels);
+    uint64_t joined_at = engine.l2_sequence();
+    std::map<double, uint64_t> asks;
+    for (size_t i = 0; i < n; i++) asks[levels[i].price] = levels[i].quantity;
+    assert(asks.size() == 1 && asks[101.0] == 15);
+
+    std::vector<L2Delta> seen;
+    engine.drain_deltas([&](const L2Delta& d) { seen.push_back(d); });
+    assert(seen.size() == 2);
+    assert(seen[0].action == LevelAction::New && seen[1].action == LevelAction::Change);
+    seen.clear();
+
+    engine.process_order(make_order(3, OrderType::Limit, Side::Sell, 102.0, 7));
+    engine.process_order(make_order(4, OrderType::Limit, Side::Sell, 103.0, 7));
+    engine.cancel_order(4);
+    // Sweep: deletes 101, partially consumes 102 → exactly two deltas
+    engine.process_order(make_order(5, OrderType::Market, Side::Buy, 0.0, 18));
+    engine.drain_deltas([&](const L2Delta& d) { seen.push_back(d); });
+    assert(seen.size() == 5);
+    assert(seen[3].action == LevelAction::Delete && seen[3].price == 101.0);
+    assert(seen[4].action == LevelAction::Change && seen[4].quantity == 4);
+
+    uint64_t expected_seq = joined_at + 1;
+    for (const L2Delta& d : seen) {
+        assert(d.side == Side::Sell);
+        assert(d.sequence == expected_seq++);
+        if (d.action == LevelAction::Delete) {
+            asks.erase(d.price);
+        } else {
+            asks[d.price] = d.quantity;
+        }
+    }
+    n = engine.snapshot(Side::Sell, 8, levels);
+    assert(n == asks.size() && n == 1);
+    assert(levels[0].price == 102.0 && asks[102.0] == levels[0].quantity);
+
+    std::cout << "TEST 13 PASSED: L2 deltas reproduce book depth" << std::endl;
+}
+
+// TEST 14: Multi-symbol engine → symbols routed to independent sharded books
+void test_multi_symbol_engine() {
+    const uint32_t kSymbols = 6;
+    std::atomic<uint64_t> filled[kSymbols] = {};
+    auto on_trade = [&filled](uint32_t symbol, const Trade& trade) {
+        filled[symbol].fetch_add(trade.quantity, std::memory_order_relaxed);
+    };
+
+    using Engine = MultiSymbolEngine<MapPriceLevels, decltype(on_trade)>;
+    Engine::Config config;
+    config.num_shards = 2;
+    config.num_symbols = kSymbols;
+    config.pin_threads = false;
+    Engine engine(config, on_trade);
+
+    // Same order IDs on every symbol: books must not interfere
+    for (uint32_t sym = 0; sym < kSymbols; sym++) {
+        engine.submit({CommandType::NewOrder, sym, make_order(1, OrderType::Limit, Side::Sell, 100.0, 10)});
+        engine.submit({CommandType::NewOrder, sym, make_order(2, OrderType::Limit, Side::Buy, 100.0, sym + 1)});
+        if (sym % 2 == 0) {
+            engine.submit({CommandType::Cancel, sym, make_order(1, OrderType::Limit, Side::Sell, 0.0, 0)});
+        }
+    }
+    engine.stop();
+
+    uint64_t commands = 0;
+    uint64_t trades = 0;
+    for (size_t shard = 0; shard < engine.num_shards(); shard++) {
+        commands += engine.shard_stats(shard).commands;
+        trades += engine.shard_stats(shard).trades;
+    }
+    assert(commands == 2 * kSymbols + kSymbols / 2);
+    assert(trades == kSymbols);
+
+    for (uint32_t sym = 0; sym < kSymbols; sym++) {
+        assert(filled[sym] == sym + 1);
+        assert(engine.engine(sym).has_asks() == (sym % 2 == 1));
+        assert(!engine.engine(sym).has_bids());
+    }
+
+    std::cout << "TEST 14 PASSED: Multi-symbol engine isolates sharded books" << std::endl;
+}
+
+// TEST 15: Ingress pipeline → gateway and shared rings feed one matching thread
+void test_engine_pipeline() {
+    const uint64_t kPerThread = 2000;
+    EnginePipeline<> pipeline(2);
+
+    auto push = [](auto& ring, const Command& command) {
+        while (!ring.try_push(command)) std::this_thread::yield();
+    };
+
+    // Two gateways own SPSC rings; two more threads share the MPSC ring.
+    // Every order is size 1 at 100.0, so all 4000 units must match exactly.
+    std::thread sellers([&] {
+        for (uint64_t i = 0; i < kPerThread; i++)
+            push(pipeline.gateway(0), {CommandType::NewOrder, 0, make_order(1 + i, OrderType::Limit, Side::Sell, 100.0, 1)});
+    });
+    std::thread buyers([&] {
+        for (uint64_t i = 0; i < kPerThread; i++)
+            push(pipeline.gateway(1), {CommandType::NewOrder, 0, make_order(100000 + i, OrderType::Limit, Side::Buy, 100.0, 1)});
+    });
+    std::thread shared_a([&] {
+        for (uint64_t i = 0; i < kPerThread; i++)
+            push(pipeline.shared(), {CommandType::NewOrder, 0, make_order(200000 + i, OrderType::Limit, Side::Sell, 100.0, 1)});
+    });
+    std::thread shared_b([&] {
+        for (uint64_t i = 0; i < kPerThread; i++)
+            push(pipeline.shared(), {CommandType::NewOrder, 0, make_order(300000 + i, OrderType::Limit, Side::Buy, 100.0, 1)});
+    });
+
+    // Every order is acknowledged: half rest, half fill against them
+    uint64_t traded = 0;
+    uint64_t acks[2] = {0, 0};
+    EgressEvent event;
+    while (traded < 2 * kPerThread || acks[0] + acks[1] < 4 * kPerThread) {
+        if (pipeline.poll(event)) {
+            if (event.type == EgressType::Trade) {
+                traded += event.trade.quantity;
+                continue;
+            }
+            assert(event.type == EgressType::OrderAck);
+            bool rested = event.status == OrderStatus::Resting;
+            assert(rested ? event.leaves == 1 : event.status == OrderStatus::Filled && event.leaves == 0);
+            acks[rested]++;
+        }
+    }
+    assert(acks[0] == 2 * kPerThread && acks[1] == 2 * kPerThread);
+    sellers.join();
+    buyers.join();
+    shared_a.join();
+    shared_b.join();
+
+    push(pipeline.shared(), {CommandType::Cancel, 0, make_order(42, OrderType::Limit, Side::Buy, 0.0, 0)});
+    pipeline.stop();
+    assert(pipeline.poll(event) && event.type == EgressType::CancelRejected && event.order_id == 42);
+    assert(!pipeline.poll(event));
+    assert(pipeline.processed() == 4 * kPerThread + 1);
+    assert(!pipeline.engine().has_bids() && !pipeline.engine().has_asks());
+
+    std::cout << "TEST 15 PASSED: Lock-free ingress pipeline applies every command" << std::endl;
+}
+
+// TEST 16: Batch processing → identical outcome to one-at-a-time processing
+void test_process_batch() {
+    std::vector<Order> batch = {
+        make_order(1, OrderType::Limit, Side::Sell, 101.0, 5),
+        make_order(2, OrderType::Limit, Side::Sell, 101.0, 5),  // Same level: one run
+        make_order(3, OrderType::Limit, Side::Sell, 101.0, 5),
+        make_order(4, OrderType::Limit, Side::Buy, 99.0, 5),
+        make_order(5, OrderType::Limit, Side::Buy, 101.0, 7),   // Crosses
+        make_order(6, OrderType::Limit, Side::Buy, 101.0, 20),  // Crosses, rests remainder
+        make_order(7, OrderType::Limit, Side::Buy, 101.0, 1),   // Joins 6 at 101
+        make_order(8, OrderType::Market, Side::Sell, 0.0, 3),
+        make_order(2, OrderType::Limit, Side::Sell, 105.0, 1),  // ID reuse after fill
+        make_order(9, OrderType::Limit, Side::Sell, 105.0, 1),  // Run of two at 105
+    };
+
+    BookConfig config;
+    config.publish_l2 = true;
+    MatchingEngine batched(config);
+    MatchingEngine sequential(config);
+
+    std::vector<Trade> batch_trades;
+    batched.process_batch(batch.data(), batch.size(), [&](const Trade& t) { batch_trades.push_back(t); });
+    std::vector<Trade> seq_trades;
+    for (const Order& o : batch) {
+        for (const Trade& t : sequential.process_order(o)) seq_trades.push_back(t);
+    }
+
+    assert(batch_trades.size() == seq_trades.size());
+    for (size_t i = 0; i < seq_trades.size(); i++) {
+        assert(batch_trades[i].buy_order_id == seq_trades[i].buy_order_id);
+        assert(batch_trades[i].sell_order_id == seq_trades[i].sell_order_id);
+        assert(batch_trades[i].quantity == seq_trades[i].quantity);
+        assert(batch_trades[i].price == seq_trades[i].price);
+    }
+    assert(batched.best_bid() == sequential.best_bid());
+    assert(batched.best_ask() == sequential.best_ask());
+    assert(batched.book().bid_quantity() == sequential.book().bid_quantity());
+    assert(batched.book().ask_count() == sequential.book().ask_count());
+    assert(batched.book().level_quantity(Side::Buy, 101.0) == 10);
+
+    // Each run (three at 101, two at 105) produced a single L2 delta
+    size_t batched_deltas = 0;
+    size_t seq_deltas = 0;
+    batched.drain_deltas([&](const L2Delta&) { batched_deltas++; });
+    sequential.drain_deltas([&](const L2Delta&) { seq_deltas++; });
+    assert(batched_deltas + 3 == seq_deltas);
+
+    std::cout << "TEST 16 PASSED: Batch processing matches sequential processing" << std::endl;
+}
+
+// TEST 17: Packed resting records → two per cache line, cold fields kept aside
+void test_packed_resting_orders() {
+    static_assert(sizeof(OrderBook<TickLadderPriceLevels>::Resting) * 2 == 64,
+                  "two resting orders per cache line");
+
+    OrderBook<TickLadderPriceLevels> book;
+    Order order = make_order(1, OrderType::Limit, Side::Sell, 100.37, 25);
+    book.add_order(order);
+    book.add_order(make_order(2, OrderType::Limit, Side::Sell, 100.37, 5));
+
+    // Front order is rebuilt from its tick price and the cold timestamp table
+    auto best = book.get_best_ask();
+    assert(best && best->id == 1);
+    assert(best->price == 100.37);
+    assert(best->quantity == 25);
+    assert(best->side == Side::Sell && best->type == OrderType::Limit);
+    assert(best->timestamp == order.timestamp);
+
+    book.modify_quantity(1, 20);
+    assert(book.get_best_ask()->quantity == 20);
+    assert(book.level_quantity(Side::Sell, 100.37) == 25);
+
+    std::cout << "TEST 17 PASSED: Packed resting records round-trip order state" << std::endl;
+}
+
+// TEST 18: Binary protocol → decoded straight into the engine, reports encoded
+void test_binary_protocol() {
+    using namespace wire;
+
+    // Little-endian on the wire regardless of host
+    uint8_t raw[8];
+    store_le<uint32_t>(raw, 0x11223344u);
+    assert(raw[0] == 0x44 && raw[3] == 0x11);
+    assert(load_le<uint32_t>(raw) == 0x11223344u);
+
+    uint8_t in[256];
+    size_t n = 0;
+    n += encode_add_order(in + n, 1, Side::Sell, 10, 100.01);
+    n += encode_add_order(in + n, 2, Side::Sell, 10, 100.02);
+    n += encode_add_order(in + n, 3, Side::Buy, 4, 100.01);     // Fills 4 of #1
+    n += encode_cancel_order(in + n, 99);                       // Unknown
+    n += encode_time_mark(in + n, 1500);                        // Pacing only, no report
+    assert(TimeMarkView{in + n - kTimeMarkSize}.nanoseconds() == 1500);
+    n += encode_replace_order(in + n, 2, 6, 100.03);            // Reprice #2
+    in[n] = 2; in[n + 1] = 0; in[n + 2] = 'Z'; in[n + 3] = 0;   // Unknown type
+    n += 4;
+    n += encode_execute_order(in + n, 4, Side::Buy, 20);        // Sweeps the rest
+    size_t complete = n;
+    n += encode_cancel_order(in + n, 1) - 3;                    // Truncated tail
+
+    MatchingEngine engine;
+    uint8_t out[512];
+    OutputEncoder encoder(out, sizeof(out));
+    assert(decode(in, n, engine, encoder) == complete);
+    assert(encoder.dropped == 0);
+    assert(!engine.has_asks() && !engine.has_bids());
+
+    // Walk the outbound stream
+    std::vector<std::pair<uint8_t, const uint8_t*>> msgs;
+    for (size_t pos = 0; pos < encoder.size;) {
+        size_t length = load_le<uint16_t>(out + pos);
+        msgs.push_back({out[pos + 2], out + pos + kHeaderSize});
+        pos += 2 + length;
+    }
+    // Adds (R, R), cross (T, R), cancel (R), replace (R), execute (T, T, R)
+    assert(msgs.size() == 9);
+    TradeView first_fill{msgs[2].second};
+    assert(msgs[2].first == TradeReport);
+    assert(first_fill.buy_order_id() == 3 && first_fill.sell_order_id() == 1);
+    assert(first_fill.quantity() == 4 && first_fill.price() == 100.01);
+
+    ExecutionReportView rest{msgs[0].second};
+    assert(rest.status() == OrderStatus::Resting && rest.leaves() == 10);
+    ExecutionReportView filled{msgs[3].second};
+    assert(filled.order_id() == 3 && filled.status() == OrderStatus::Filled && filled.executed() == 4);
+    assert(ExecutionReportView{msgs[4].second}.status() == OrderStatus::Rejected);
+    ExecutionReportView replaced{msgs[5].second};
+    assert(replaced.order_id() == 2 && replaced.leaves() == 6);
+
+    TradeView sweep{msgs[7].second};
+    assert(sweep.sell_order_id() == 2 && sweep.quantity() == 6 && sweep.price() == 100.03);
+    ExecutionReportView market{msgs[8].second};
+    assert(market.status() == OrderStatus::Cancelled && market.executed() == 12 && market.leaves() == 0);
+
+    // Orders with attributes beyond 'A' / 'E' travel as EnterOrder
+    Order stop = make_order(5, OrderType::StopLimit, Side::Sell, 99.50, 7);
+    stop.stop_price = 99.75;
+    stop.tif = TimeInForce::IOC;
+    stop.account = 3;
+    stop.stp = SelfTradePolicy::DecrementBoth;
+    uint8_t msg[64];
+    assert(encode_order(msg, stop) == kHeaderSize + kEnterOrderSize && msg[2] == EnterOrder);
+    Order decoded;
+    assert(EnterOrderView{msg + kHeaderSize}.to_order(decoded));
+    assert(decoded.id == 5 && decoded.type == OrderType::StopLimit && decoded.side == Side::Sell);
+    assert(decoded.price == 99.50 && decoded.stop_price == 99.75 && decoded.quantity == 7);
+    assert(decoded.tif == TimeInForce::IOC && decoded.account == 3 && !decoded.post_only);
+    assert(decoded.stp == SelfTradePolicy::DecrementBoth && decoded.display_quantity == 0);
+    assert(encode_order(msg, make_order(6, OrderType::Limit, Side::Buy, 99.0, 1)) == kHeaderSize + kAddOrderSize);
+    assert(encode_order(msg, make_order(7, OrderType::Market, Side::Buy, 0, 1)) == kHeaderSize + kExecuteOrderSize);
+    encode_order(msg, stop);
+    msg[kHeaderSize + 9] = 9; // No such order type
+    MatchingEngine strict;
+    OutputEncoder report(out, sizeof(out));
+    assert(decode(msg, kHeaderSize + kEnterOrderSize, strict, report) == kHeaderSize + kEnterOrderSize);
+    assert(ExecutionReportView{out + kHeaderSize}.status() == OrderStatus::Rejected);
+
+    // A stop the message triggers gets its own report, and only the
+    // message's own fills count towards its report
+    Order trigger_stop = make_order(12, OrderType::StopLimit, Side::Buy, 101.0, 6);
+    trigger_stop.stop_price = 100.0;
+    n = encode_add_order(in, 10, Side::Sell, 3, 100.0);
+    n += encode_add_order(in + n, 11, Side::Sell, 2, 101.0);
+    n += encode_order(in + n, trigger_stop);
+    n += encode_execute_order(in + n, 13, Side::Buy, 1); // Trades at 100: releases #12
+    MatchingEngine stops;
+    OutputEncoder stream(out, sizeof(out));
+    assert(decode(in, n, stops, stream) == n);
+    msgs.clear();
+    for (size_t pos = 0; pos < stream.size;) {
+        msgs.push_back({out[pos + 2], out + pos + kHeaderSize});
+        pos += 2 + load_le<uint16_t>(out + pos);
+    }
+    // R, R, R (pending), T (#13), T, T (#12), R (#12), R (#13)
+    assert(msgs.size() == 8 && msgs[3].first == TradeReport && msgs[5].first == TradeReport);
+    ExecutionReportView pending{msgs[2].second};
+    assert(pending.order_id() == 12 && pending.status() == OrderStatus::Pending);
+    ExecutionReportView released{msgs[6].second};
+    assert(released.order_id() == 12 && released.status() == OrderStatus::Resting);
+    assert(released.executed() == 4 && released.leaves() == 2);
+    ExecutionReportView aggressor{msgs[7].second};
+    assert(aggressor.order_id() == 13 && aggressor.status() == OrderStatus::Filled);
+    assert(aggressor.executed() == 1 && aggressor.leaves() == 0);
+
+    std::cout << "TEST 18 PASSED: Binary protocol decodes into engine and encodes reports" << std::endl;
+}
+
+// TEST 19: Journal → records survive reopen, replay rebuilds the same book
+void test_journal_replay() {
+    char path[] = "/tmp/orderbook_journal_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    uint8_t in[256];
+    size_t n = 0;
+    n += wire::encode_add_order(in + n, 1, Side::Sell, 10, 100.02);
+    n += wire::encode_add_order(in + n, 2, Side::Sell, 5, 100.03);
+    n += wire::encode_add_order(in + n, 3, Side::Buy, 8, 99.99);
+    n += wire::encode_add_order(in + n, 4, Side::Buy, 4, 100.02);   // Fills 4 of #1
+    n += wire::encode_cancel_order(in + n, 3);
+    size_t complete = n;
+    n += wire::encode_add_order(in + n, 5, Side::Buy, 1, 99.00) - 5; // Partial tail
+
+    MatchingEngine live;
+    wire::NullHandler ignore;
+    JournalConfig config;
+    config.capacity = 4096;
+    config.flush_bytes = 32; // Several automatic flushes
+    config.fsync = FsyncPolicy::Sync;
+    {
+        JournalWriter journal(path, config);
+        assert(journal.is_open() && journal.size() == 0);
+        assert(journal_and_decode(journal, in, n, live, ignore) == complete);
+        assert(journal.size() == complete);
+    }
+
+    // Reopening resumes after the last record
+    uint8_t more[64];
+    size_t m = wire::encode_add_order(more, 6, Side::Buy, 3, 100.01);
+    {
+        JournalWriter journal(path, config);
+        assert(journal.is_open() && journal.size() == complete);
+        assert(journal_and_decode(journal, more, m, live, ignore) == m);
+    }
+
+    MappedJournal mapped(path);
+    assert(mapped.is_open() && mapped.size() == complete + m);
+    MatchingEngine restored;
+    assert(mapped.replay(restored) == mapped.size());
+    assert(restored.best_bid() == live.best_bid() && *restored.best_bid() == 100.01);
+    assert(restored.best_ask() == live.best_ask() && *restored.best_ask() == 100.02);
+    assert(restored.book().bid_count() == live.book().bid_count());
+    assert(restored.book().ask_count() == 2);
+    assert(!restored.book().find_order(3).has_value());
+    assert(restored.book().find_order(1)->quantity == 6);
+
+    // Tail replay resumes from an offset, e.g. after a snapshot
+    MatchingEngine partial;
+    size_t offset = mapped.replay(partial);
+    assert(mapped.replay(partial, offset) == offset);
+
+    // Records are committed by the header only at a flush
+    {
+        config.flush_bytes = 1 << 20;
+        JournalWriter journal(path, config);
+        assert(journal.append(more, m) && journal.size() == complete + 2 * m);
+        assert(journal.committed() == complete + m);
+        assert(MappedJournal(path).size() == complete + m);
+        assert(journal.flush() && journal.committed() == journal.size());
+        assert(MappedJournal(path).size() == complete + 2 * m);
+    }
+
+    // A full journal refuses records rather than truncating them
+    {
+        config.capacity = complete;
+        std::remove(path);
+        JournalWriter small(path, config);
+        assert(small.append(in, complete));
+        assert(!small.append(more, m));
+        assert(small.size() == complete);
+    }
+    std::remove(path);
+
+    // Every order attribute survives the journal: stops, time in force,
+    // post-only, icebergs, accounts and self-trade policy
+    std::vector<Order> orders;
+    Order iceberg = make_order(10, OrderType::Limit, Side::Sell, 100.05, 30);
+    iceberg.display_quantity = 10;
+    iceberg.account = 1;
+    iceberg.stp = SelfTradePolicy::CancelOldest;
+    orders.push_back(iceberg);
+    Order maker = make_order(11, OrderType::Limit, Side::Buy, 99.90, 5);
+    maker.post_only = true;
+    maker.account = 2;
+    orders.push_back(maker);
+    Order stop = make_order(12, OrderType::Stop, Side::Buy, 0, 5);
+    stop.stop_price = 100.05;
+    stop.account = 2;
+    orders.push_back(stop);
+    Order stop_limit = make_order(13, OrderType::StopLimit, Side::Sell, 98.90, 3);
+    stop_limit.stop_price = 99.00;
+    orders.push_back(stop_limit);
+    Order ioc = make_order(14, OrderType::Limit, Side::Buy, 100.05, 4); // Trades, fires #12
+    ioc.tif = TimeInForce::IOC;
+    ioc.account = 2;
+    orders.push_back(ioc);
+    Order fok = make_order(15, OrderType::Limit, Side::Buy, 100.05, 100);
+    fok.tif = TimeInForce::FOK;
+    orders.push_back(fok);
+    Order taker = make_order(16, OrderType::Limit, Side::Buy, 100.05, 1);
+    taker.post_only = true;
+    orders.push_back(taker);
+    Order own = make_order(17, OrderType::Limit, Side::Buy, 100.05, 2); // Meets #10's account
+    own.account = 1;
+    own.stp = SelfTradePolicy::CancelNewest;
+    orders.push_back(own);
+
+    std::remove(path);
+    config.capacity = 4096;
+    MatchingEngine primary;
+    {
+        JournalWriter journal(path, config);
+        uint8_t msg[64];
+        for (const Order& order : orders) {
+            size_t size = wire::encode_order(msg, order);
+            assert(journal_and_decode(journal, msg, size, primary, ignore) == size);
+        }
+    }
+    assert(primary.pending_stops() == 1 && primary.book().find_order(10)->quantity == 21);
+    MatchingEngine replayed;
+    MappedJournal attributes(path);
+    assert(attributes.replay(replayed) == attributes.size());
+    assert(replayed.pending_stops() == 1 && replayed.last_trade_price() == primary.last_trade_price());
+    for (uint64_t id : {10, 11}) {
+        Order want = *primary.book().find_order(id);
+        Order got = *replayed.book().find_order(id);
+        assert(got.quantity == want.quantity && got.display_quantity == want.display_quantity);
+        assert(got.account == want.account && got.stp == want.stp && got.post_only == want.post_only);
+    }
+    assert(replayed.book().find_order(11)->post_only && replayed.book().find_order(10)->display_quantity == 10);
+    assert(replayed.exposure(2)->bought == 9 && primary.exposure(2)->bought == 9);
+    assert(replayed.exposure(1)->sold == primary.exposure(1)->sold);
+    assert(!replayed.book().find_order(15) && !replayed.book().find_order(16) && !replayed.book().find_order(17));
+    // The replayed stop-limit is live: a trade at 99.00 fires it in both
+    for (MatchingEngine<>* engine : {&primary, &replayed}) {
+        engine->process_order(make_order(18, OrderType::Limit, Side::Buy, 99.00, 1));
+        engine->process_order(make_order(19, OrderType::Limit, Side::Sell, 99.00, 6));
+        assert(engine->pending_stops() == 0 && engine->book().find_order(13)->price == 98.90);
+    }
+    std::remove(path);
+
+    std::cout << "TEST 19 PASSED: Journal appends across reopen and replays into an identical book" << std::endl;
+}
+
+// TEST 20: Snapshot → restore rebuilds levels, FIFO and index; journal tail on top
+void test_snapshot_restore() {
+    BookConfig config;
+    config.publish_l2 = true;
+    MatchingEngine<TickLadderPriceLevels> live(config);
+    live.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.02, 10));
+    live.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.02, 7));
+    live.process_order(make_order(3, OrderType::Limit, Side::Sell, 100.05, 3));
+    live.process_order(make_order(4, OrderType::Limit, Side::Buy, 99.98, 5));
+    live.process_order(make_order(5, OrderType::Limit, Side::Buy, 99.99, 6));
+    live.process_order(make_order(6, OrderType::Limit, Side::Buy, 99.99, 2));
+    live.process_order(make_order(7, OrderType::Market, Side::Buy, 0, 4)); // #1 -> 6
+    live.cancel_order(4);
+    Order stop = make_order(9, OrderType::Stop, Side::Sell, 0, 3);
+    stop.stop_price = 98.0;
+    assert(live.process_order(stop).empty() && live.pending_stops() == 1);
+
+    // The engine image: book, then last price, stops and the rest
+    std::vector<uint8_t> image;
+    live.save_snapshot(image, 1234);
+    assert(image.size() == sizeof(SnapshotHeader) + 3 * sizeof(SnapshotLevel) + 5 * sizeof(SnapshotOrder) +
+                               sizeof(SnapshotEngineState) + sizeof(SnapshotStop));
+
+    // Restores into a different level store; the index is usable at once
+    MatchingEngine restored;
+    assert(restored.restore_snapshot(image.data(), image.size()) == 1234u);
+    assert(restored.book().bid_count() == 2 && restored.book().ask_count() == 3);
+    assert(restored.book().level_quantity(Side::Sell, 100.02) == 13);
+    assert(restored.book().level_order_count(Side::Buy, 99.99) == 2);
+    assert(restored.l2_sequence() == live.l2_sequence());
+    assert(restored.pending_stops() == 1 && restored.last_trade_price() == 100.02);
+    assert(restored.book().find_order(1)->quantity == 6);
+    assert(restored.book().find_order(6)->sequence == live.book().find_order(6)->sequence);
+    assert(restored.cancel_order(5));
+    assert(restored.best_bid() == 99.99); // #6 remains
+
+    // Time priority survives: #1 still fills ahead of #2
+    auto trades = restored.process_order(make_order(8, OrderType::Market, Side::Buy, 0, 8));
+    assert(trades.size() == 2 && trades[0].sell_order_id == 1 && trades[1].sell_order_id == 2);
+    assert(trades[0].quantity == 6 && trades[1].quantity == 2);
+
+    // Rejects a non-empty book and damaged images
+    assert(!restored.restore_snapshot(image.data(), image.size()));
+    MatchingEngine fresh;
+    assert(!fresh.restore_snapshot(image.data(), image.size() - 1));
+    std::vector<uint8_t> bad = image;
+    bad[0] ^= 0xFF;
+    assert(!fresh.restore_snapshot(bad.data(), bad.size()));
+    assert(!fresh.has_bids() && !fresh.has_asks());
+
+    // Startup: forked snapshot while the parent keeps matching, then the
+    // journal tail from the recorded offset
+    char snap[] = "/tmp/orderbook_snapshot_XXXXXX";
+    char jrnl[] = "/tmp/orderbook_journal_XXXXXX";
+    close(mkstemp(snap));
+    close(mkstemp(jrnl));
+    std::remove(jrnl);
+    MatchingEngine primary;
+    wire::NullHandler ignore;
+    uint8_t msg[64];
+    {
+        JournalConfig jconfig;
+        jconfig.capacity = 4096;
+        JournalWriter journal(jrnl, jconfig);
+        size_t n = wire::encode_add_order(msg, 1, Side::Buy, 5, 99.50);
+        journal_and_decode(journal, msg, n, primary, ignore);
+        n = wire::encode_add_order(msg, 2, Side::Sell, 5, 100.50);
+        journal_and_decode(journal, msg, n, primary, ignore);
+
+        pid_t child = primary.fork_snapshot(snap, journal.size());
+        n = wire::encode_add_order(msg, 3, Side::Buy, 2, 100.50); // Fills against #2
+        journal_and_decode(journal, msg, n, primary, ignore);
+        n = wire::encode_cancel_order(msg, 1);
+        journal_and_decode(journal, msg, n, primary, ignore);
+        assert(wait_snapshot(child));
+    }
+
+    MatchingEngine recovered;
+    auto offset = recovered.restore_snapshot(snap);
+    assert(offset && recovered.book().bid_count() == 1 && recovered.book().ask_count() == 1);
+    MappedJournal journal(jrnl);
+    assert(journal.replay(recovered, *offset) == journal.size());
+    assert(!recovered.has_bids() && recovered.book().find_order(2)->quantity == 3);
+    assert(recovered.book().ask_quantity() == primary.book().ask_quantity());
+    std::remove(snap);
+    std::remove(jrnl);
+
+    std::cout << "TEST 20 PASSED: Snapshot restores FIFO state and resumes from the journal" << std::endl;
+}
+
+// TEST 21: Replace → in-place reduce keeps priority, reprice moves the node, crossing trades
+void test_replace_order() {
+    MatchingEngine<TickLadderPriceLevels> engine;
+    std::vector<Trade> trades;
+    auto sink = [&](const Trade& trade) { trades.push_back(trade); };
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.02, 10));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.02, 10));
+    engine.process_order(make_order(3, OrderType::Limit, Side::Buy, 99.98, 5));
+    size_t high_water = engine.book().order_pool().high_water_mark();
+
+    // Less quantity at the same price: #1 keeps the front of the queue
+    assert(engine.replace_order(1, 100.02, 4, sink) == OrderStatus::Resting);
+    assert(engine.book().level_quantity(Side::Sell, 100.02) == 14);
+    assert(engine.book().get_best_ask()->id == 1);
+
+    // More quantity at the same price: priority lost
+    assert(engine.replace_order(1, 100.02, 6, sink) == OrderStatus::Resting);
+    assert(engine.book().get_best_ask()->id == 2);
+    assert(engine.book().level_order_count(Side::Sell, 100.02) == 2);
+
+    // Reprice away from the touch: node moved, old level kept for #2
+    assert(engine.replace_order(2, 100.04, 10, sink) == OrderStatus::Resting);
+    assert(engine.best_ask() == 100.02 && engine.book().level_quantity(Side::Sell, 100.04) == 10);
+    assert(engine.book().ask_levels() == 2 && engine.book().ask_quantity() == 16);
+
+    // Reprice the bid through the ask: trades as aggressor, remainder rests
+    assert(engine.replace_order(3, 100.02, 8, sink) == OrderStatus::Resting);
+    assert(trades.size() == 1 && trades[0].buy_order_id == 3 && trades[0].sell_order_id == 1);
+    assert(trades[0].quantity == 6 && trades[0].price == 100.02);
+    assert(engine.best_bid() == 100.02 && engine.book().find_order(3)->quantity == 2);
+    assert(engine.best_ask() == 100.04 && !engine.book().find_order(1));
+    assert(engine.book().level_quantity(Side::Buy, 99.98) == 0);
+
+    // Fully filled by the reprice: leaves the book
+    trades.clear();
+    assert(engine.replace_order(3, 100.05, 1, sink) == OrderStatus::Filled);
+    assert(trades.size() == 1 && trades[0].quantity == 1 && trades[0].sell_order_id == 2);
+    assert(!engine.has_bids() && engine.book().bid_count() == 0);
+
+    // Nothing was freed and reallocated along the way
+    assert(engine.book().order_pool().high_water_mark() == high_water);
+
+    // Unknown, off-grid and zero-quantity replaces
+    assert(engine.replace_order(99, 100.00, 1, sink) == OrderStatus::Rejected);
+    assert(engine.replace_order(2, 100.045, 1, sink) == OrderStatus::Rejected);
+    assert(engine.book().find_order(2)->quantity == 9);
+    assert(engine.replace_order(2, 100.04, 0, sink) == OrderStatus::Cancelled);
+    assert(!engine.has_asks());
+
+    // Through the command path
+    engine.process_order(make_order(4, OrderType::Limit, Side::Buy, 99.00, 5));
+    Command replace{CommandType::Replace, 0, make_order(4, OrderType::Limit, Side::Buy, 99.50, 3)};
+    assert(engine.apply(replace, sink));
+    assert(engine.best_bid() == 99.50 && engine.book().bid_quantity() == 3);
+    replace.order.id = 5;
+    assert(!engine.apply(replace, sink));
+
+    // A post-only order stays passive: repricing it through the touch is
+    // rejected and leaves it where it was
+    Order maker = make_order(6, OrderType::Limit, Side::Sell, 100.10, 4);
+    maker.post_only = true;
+    engine.process_order(maker, sink);
+    assert(engine.book().find_order(6)->post_only);
+    trades.clear();
+    assert(engine.replace_order(6, 99.50, 4, sink) == OrderStatus::Rejected);
+    assert(trades.empty() && engine.best_ask() == 100.10 && engine.best_bid() == 99.50);
+    assert(engine.replace_order(6, 99.60, 2, sink) == OrderStatus::Resting); // Still passive
+    assert(engine.best_ask() == 99.60 && engine.book().find_order(6)->post_only);
+
+    std::cout << "TEST 21 PASSED: Replace amends in place and crosses when repriced through" << std::endl;
+}
+
+// TEST 22: Iceberg → slice refilled from reserve and requeued behind the level
+void test_iceberg_orders() {
+    MatchingEngine engine;
+    Order iceberg = make_order(1, OrderType::Limit, Side::Sell, 100.0, 25);
+    iceberg.display_quantity = 10;
+    engine.process_order(iceberg);
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.0, 10));
+
+    // Only the slice is displayed; find_order reports the whole order
+    assert(engine.book().level_quantity(Side::Sell, 100.0) == 20);
+    assert(engine.book().ask_quantity() == 20);
+    auto found = engine.book().find_order(1);
+    assert(found->quantity == 25 && found->display_quantity == 10);
+    size_t hashed = engine.book().order_index().hashed_size();
+    size_t high_water = engine.book().order_pool().high_water_mark();
+
+    // Slice filled: refilled to 10 and queued behind #2
+    auto trades = engine.process_order(make_order(3, OrderType::Market, Side::Buy, 0, 15));
+    assert(trades.size() == 2);
+    assert(trades[0].sell_order_id == 1 && trades[0].quantity == 10);
+    assert(trades[1].sell_order_id == 2 && trades[1].quantity == 5);
+    assert(engine.book().get_best_ask()->id == 2);
+    assert(engine.book().level_quantity(Side::Sell, 100.0) == 15);
+    assert(engine.book().level_order_count(Side::Sell, 100.0) == 2);
+
+    // Sweep: #2, then #1's slice, its last (short) slice, and done
+    trades = engine.process_order(make_order(4, OrderType::Market, Side::Buy, 0, 100));
+    assert(trades.size() == 3);
+    assert(trades[0].sell_order_id == 2 && trades[0].quantity == 5);
+    assert(trades[1].sell_order_id == 1 && trades[1].quantity == 10);
+    assert(trades[2].sell_order_id == 1 && trades[2].quantity == 5);
+    assert(!engine.has_asks() && engine.book().ask_quantity() == 0);
+
+    // No lookups or allocations were spent on the refills
+    assert(engine.book().order_index().hashed_size() + 2 == hashed);
+    assert(engine.book().order_pool().high_water_mark() == high_water);
+
+    // An aggressive iceberg trades in full, then rests only a slice
+    engine.process_order(make_order(5, OrderType::Limit, Side::Sell, 100.0, 10));
+    Order buyer = make_order(6, OrderType::Limit, Side::Buy, 100.0, 30);
+    buyer.display_quantity = 4;
+    trades = engine.process_order(buyer);
+    assert(trades.size() == 1 && trades[0].quantity == 10);
+    assert(engine.book().bid_quantity() == 4 && engine.book().find_order(6)->quantity == 20);
+
+    // Replace keeps the display size; a same-price reduce eats reserve first
+    auto ignore = [](const Trade&) {};
+    assert(engine.replace_order(6, 100.0, 12, ignore) == OrderStatus::Resting);
+    assert(engine.book().bid_quantity() == 4 && engine.book().find_order(6)->quantity == 12);
+    assert(engine.replace_order(6, 99.0, 30, ignore) == OrderStatus::Resting);
+    assert(engine.book().level_quantity(Side::Buy, 99.0) == 4);
+
+    // The reserve survives a snapshot round trip
+    std::vector<uint8_t> image;
+    engine.save_snapshot(image);
+    MatchingEngine restored;
+    assert(restored.restore_snapshot(image.data(), image.size()));
+    assert(restored.book().find_order(6)->quantity == 30);
+    assert(restored.book().find_order(6)->display_quantity == 4);
+
+    assert(engine.cancel_order(6) && !engine.has_bids());
+
+    std::cout << "TEST 22 PASSED: Iceberg slices replenish in place and requeue" << std::endl;
+}
+
+// TEST 23: Time in force → IOC/FOK/post-only decided without stray resting nodes
+void test_time_in_force() {
+    MatchingEngine engine;
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.0, 5));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.5, 5));
+    size_t high_water = engine.book().order_pool().high_water_mark();
+    auto ignore = [](const Trade&) {};
+
+    // IOC: trades what crosses, discards the rest
+    Order ioc = make_order(3, OrderType::Limit, Side::Buy, 100.0, 8);
+    ioc.tif = TimeInForce::IOC;
+    std::vector<Trade> trades;
+    assert(engine.process_order(ioc, [&](const Trade& t) { trades.push_back(t); }) == OrderStatus::Cancelled);
+    assert(trades.size() == 1 && trades[0].quantity == 5);
+    assert(!engine.has_bids() && !engine.book().find_order(3));
+
+    // FOK: 6 available up to 100.5 but 8 asked: nothing trades
+    engine.process_order(make_order(4, OrderType::Limit, Side::Sell, 100.5, 1));
+    Order fok = make_order(5, OrderType::Limit, Side::Buy, 100.5, 8);
+    fok.tif = TimeInForce::FOK;
+    assert(engine.process_order(fok, ignore) == OrderStatus::Cancelled);
+    assert(engine.book().ask_quantity() == 6 && !engine.has_bids());
+    fok.quantity = 6;
+    assert(engine.process_order(fok, ignore) == OrderStatus::Filled);
+    assert(!engine.has_asks());
+
+    // FOK market against an empty book: nothing to fill
+    Order fok_market = make_order(6, OrderType::Market, Side::Buy, 0, 1);
+    fok_market.tif = TimeInForce::FOK;
+    assert(engine.process_order(fok_market, ignore) == OrderStatus::Cancelled);
+
+    // Post-only: rests if passive, rejected if it would take
+    Order maker = make_order(7, OrderType::Limit, Side::Sell, 101.0, 3);
+    maker.post_only = true;
+    assert(engine.process_order(maker, ignore) == OrderStatus::Resting);
+    Order taker = make_order(8, OrderType::Limit, Side::Buy, 101.0, 3);
+    taker.post_only = true;
+    assert(engine.process_order(taker, ignore) == OrderStatus::Rejected);
+    assert(engine.book().ask_quantity() == 3 && !engine.has_bids());
+
+    // Non-crossing IOC in a batch never joins an add run
+    Order batch[3] = {make_order(9, OrderType::Limit, Side::Buy, 99.0, 1),
+                      make_order(10, OrderType::Limit, Side::Buy, 99.0, 1),
+                      make_order(11, OrderType::Limit, Side::Buy, 99.0, 1)};
+    batch[1].tif = TimeInForce::IOC;
+    engine.process_batch(batch, 3, ignore);
+    assert(engine.book().bid_count() == 2 && !engine.book().find_order(10));
+
+    // Only the maker and the two GTC bids ever needed extra nodes
+    assert(engine.book().order_pool().high_water_mark() <= high_water + 3);
+
+    std::cout << "TEST 23 PASSED: IOC, FOK and post-only resolve before resting" << std::endl;
+}
+
+Order make_stop(uint64_t id, OrderType type, Side side, double stop, double price, uint32_t qty) {
+    Order o = make_order(id, type, side, price, qty);
+    o.stop_price = stop;
+    return o;
+}
+
+// TEST 24: Stops → parked by stop price, triggered by trades, cascade bounded
+void test_stop_orders() {
+    MatchingEngine engine;
+    engine.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.0, 5));
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 101.0, 5));
+    engine.process_order(make_order(3, OrderType::Limit, Side::Sell, 102.0, 5));
+    engine.process_order(make_order(4, OrderType::Limit, Side::Buy, 99.0, 10));
+    assert(!engine.last_trade_price());
+
+    std::vector<Trade> trades;
+    auto sink = [&](const Trade& t) { trades.push_back(t); };
+    assert(engine.process_order(make_stop(10, OrderType::Stop, Side::Buy, 100.5, 0, 5), sink) == OrderStatus::Pending);
+    assert(engine.process_order(make_stop(11, OrderType::StopLimit, Side::Buy, 101.0, 101.0, 3), sink) == OrderStatus::Pending);
+    assert(engine.process_order(make_stop(12, OrderType::Stop, Side::Sell, 98.0, 0, 1), sink) == OrderStatus::Pending);
+    assert(engine.process_order(make_stop(12, OrderType::Stop, Side::Sell, 97.0, 0, 1), sink) == OrderStatus::Rejected);
+    assert(engine.pending_stops() == 3);
+    // ... and so is a plain order reusing a pending stop's ID, alone or in a batch
+    assert(engine.process_order(make_order(12, OrderType::Limit, Side::Buy, 90.0, 1), sink) == OrderStatus::Rejected);
+    Order reused[] = {make_order(30, OrderType::Limit, Side::Buy, 90.0, 1),
+                      make_order(12, OrderType::Limit, Side::Buy, 90.0, 1)};
+    engine.process_batch(reused, 2, sink);
+    assert(engine.book().find_order(30) && !engine.book().find_order(12));
+    assert(engine.cancel_order(30) && engine.pending_stops() == 3);
+
+    // Trade at 100: below both buy stops
+    engine.process_order(make_order(20, OrderType::Market, Side::Buy, 0, 5), sink);
+    assert(trades.size() == 1 && engine.pending_stops() == 3);
+
+    // Trade at 101 triggers #10 (market), whose fill at 102 triggers #11
+    trades.clear();
+    engine.process_order(make_order(21, OrderType::Market, Side::Buy, 0, 1), sink);
+    assert(trades.size() == 3);
+    assert(trades[0].buy_order_id == 21 && trades[0].price == 101.0);
+    assert(trades[1].buy_order_id == 10 && trades[1].price == 101.0 && trades[1].quantity == 4);
+    assert(trades[2].buy_order_id == 10 && trades[2].price == 102.0 && trades[2].quantity == 1);
+    assert(*engine.last_trade_price() == 102.0);
+    assert(engine.best_bid() == 101.0 && engine.book().find_order(11)->quantity == 3);
+
+    // Pending stops can be cancelled; a stop already reached runs at once
+    assert(engine.cancel_order(12) && engine.pending_stops() == 0);
+    assert(!engine.cancel_order(12));
+    trades.clear();
+    assert(engine.process_order(make_stop(13, OrderType::Stop, Side::Buy, 101.0, 0, 2), sink) == OrderStatus::Filled);
+    assert(trades.size() == 1 && trades[0].sell_order_id == 3);
+
+    // At most max_stop_triggers stops run per call; the rest wait
+    BookConfig config;
+    config.max_stop_triggers = 2;
+    MatchingEngine bounded(config);
+    for (uint64_t id = 1; id <= 5; id++) {
+        bounded.process_order(make_order(id, OrderType::Limit, Side::Sell, 100.0, 1));
+        bounded.process_order(make_stop(100 + id, OrderType::Stop, Side::Buy, 100.0, 0, 1), sink);
+    }
+    bounded.process_order(make_order(6, OrderType::Limit, Side::Buy, 100.0, 1));
+    assert(bounded.pending_stops() == 3 && bounded.stops_triggered());
+    assert(bounded.book().ask_count() == 2);
+    assert(bounded.process_stops(sink) && bounded.pending_stops() == 1);
+    assert(!bounded.has_asks());
+    assert(!bounded.process_stops(sink) && bounded.pending_stops() == 0); // Nothing left to buy
+
+    // A batch releases held-back stops just as one order at a time does:
+    // resting orders never form one run past a waiting trigger
+    config.max_stop_triggers = 1;
+    MatchingEngine sequential(config), batched(config);
+    size_t fills[2] = {0, 0};
+    Order rests[] = {make_order(7, OrderType::Limit, Side::Buy, 99.0, 5),
+                     make_order(8, OrderType::Limit, Side::Buy, 99.0, 5)};
+    for (int e = 0; e < 2; e++) {
+        MatchingEngine<>& copy = e == 0 ? sequential : batched;
+        auto count = [&](const Trade&) { fills[e]++; };
+        copy.process_order(make_order(1, OrderType::Limit, Side::Sell, 100.0, 6), count);
+        copy.process_order(make_stop(2, OrderType::Stop, Side::Buy, 100.0, 0, 2), count);
+        copy.process_order(make_stop(3, OrderType::Stop, Side::Buy, 100.0, 0, 2), count);
+        copy.process_order(make_order(4, OrderType::Market, Side::Buy, 0, 1), count); // Releases #2 only
+        assert(copy.stops_triggered());
+        if (e == 0) {
+            for (const Order& order : rests) copy.process_order(order, count);
+        } else {
+            copy.process_batch(rests, 2, count);
+        }
+    }
+    assert(fills[0] == 3 && fills[1] == fills[0]);
+    assert(batched.pending_stops() == 0 && sequential.pending_stops() == 0);
+    assert(batched.book().bid_quantity() == sequential.book().bid_quantity());
+    assert(batched.book().ask_quantity() == 1);
+
+    std::cout << "TEST 24 PASSED: Stops trigger off last trade with a bounded cascade" << std::endl;
+}
+
+// TEST 25: Benchmark tooling → histogram percentiles within bucket precision, reproducible workloads
+void test_histogram_and_workload() {
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 100000; v++) {
+        h.record(v);
+    }
+    assert(h.count() == 100000 && h.min() == 1 && h.max() == 100000);
+    assert(h.mean() == 50000.5);
+    for (double p : {0.5, 0.9, 0.99, 0.999, 0.9999}) {
+        double exact = p * 100000;
+        double got = static_cast<double>(h.percentile(p));
+        assert(got >= exact && got <= exact * (1 + 1.0 / LatencyHistogram::kHalf) + 1);
+    }
+    assert(h.percentile(1.0) == 100000);
+    h.record(uint64_t(1) << 40); // Huge outliers are still representable
+    assert(h.max() == uint64_t(1) << 40 && h.percentile(1.0) == h.max());
+
+    LatencyHistogram small;
+    small.record(7);
+    small.record(7);
+    assert(small.percentile(0.5) == 7 && small.percentile(0.9999) == 7); // Exact below 256
+    h.merge(small);
+    assert(h.count() == 100003 && h.min() == 1);
+
+    WorkloadConfig config;
+    config.operations = 20000;
+    config.book_depth = 1000;
+    Workload a = generate_workload(config);
+    Workload b = generate_workload(config);
+    assert(a.setup.size() == 1000 && a.events.size() == 20000);
+    size_t adds = 0, cancels = 0, aggressive = 0;
+    for (size_t i = 0; i < a.events.size(); i++) {
+        const Command& e = a.events[i];
+        assert(e.type == b.events[i].type && e.order.id == b.events[i].order.id); // Seeded
+        if (e.type == CommandType::Cancel) cancels++;
+        else if (e.order.type == OrderType::Market) aggressive++;
+        else {
+            adds++;
+            // Passive: never at or through the mid
+            assert(e.order.side == Side::Buy ? e.order.price < 100.0 : e.order.price > 100.0);
+        }
+    }
+    assert(adds > 11500 && adds < 12500 && cancels > 6500 && cancels < 7500 && aggressive > 700);
+    assert(std::is_sorted(a.arrival_ns.begin(), a.arrival_ns.end()));
+    double mean_gap = static_cast<double>(a.arrival_ns.back()) / a.arrival_ns.size();
+    assert(mean_gap > 900 && mean_gap < 1100); // 1e6 events/s
+
+    // The whole stream applies cleanly to a book
+    MatchingEngine<TickLadderPriceLevels> engine;
+    size_t trades = 0;
+    for (const Command& c : a.setup) engine.apply(c, [](const Trade&) {});
+    for (const Command& c : a.events) engine.apply(c, [&](const Trade&) { trades++; });
+    assert(trades > 0 && engine.has_bids() && engine.has_asks());
+
+    std::cout << "TEST 25 PASSED: Histogram percentiles and seeded workloads behave" << std::endl;
+}
+
+// TEST 26: Hot-path instrumentation → per-stage counts when compiled in, nothing otherwise
+void test_instrumentation() {
+    CycleHistogram histogram;
+    for (uint64_t c : {0, 1, 100, 100, 5000}) histogram.record(c);
+    CycleSnapshot read = histogram.read();
+    assert(read.count == 5 && read.cycles == 5201 && read.max == 5000);
+    assert(read.buckets[0] == 1 && read.buckets[1] == 1 && read.buckets[7] == 2); // 100: [64, 128)
+    assert(read.percentile(0.5) == 127 && read.percentile(1.0) == 5000);
+
+    auto limits = read_message(MessageKind::Limit).count;
+    auto inserts = read_stage(Stage::BookInsert).count;
+    auto fills = read_stage(Stage::FillLoop).count;
+    auto index = read_stage(Stage::IndexUpdate).count;
+
+    // A side thread reads while this one matches: counts only go up
+    std::atomic<bool> done{false};
+    std::thread observer([&] {
+        uint64_t last = 0;
+        while (!done.load()) {
+            uint64_t now = read_message(MessageKind::Limit).count;
+            assert(now >= last);
+            last = now;
+        }
+    });
+    MatchingEngine engine;
+    for (uint64_t id = 1; id <= 100; id++) {
+        engine.process_order({id, OrderType::Limit, id % 2 ? Side::Buy : Side::Sell,
+                              id % 2 ? 99.0 : 101.0, 10, {}}, [](const Trade&) {});
+    }
+    engine.process_order({101, OrderType::Market, Side::Buy, 0, 25, {}}, [](const Trade&) {});
+    engine.cancel_order(1);
+    done = true;
+    observer.join();
+
+    uint64_t expect = kInstrumented ? 1 : 0;
+    assert(read_message(MessageKind::Limit).count - limits == 100 * expect);
+    assert(read_message(MessageKind::Market).count >= expect);
+    assert(read_stage(Stage::BookInsert).count - inserts == 100 * expect);
+    assert(read_stage(Stage::FillLoop).count - fills == 101 * expect); // Every limit checks the other side
+    assert(read_stage(Stage::IndexUpdate).count - index == 103 * expect); // 100 inserts, 2 filled, 1 cancel
+    if (!kInstrumented) {
+        assert(read_stage(Stage::Dispatch).count == 0); // Nothing registered at all
+    }
+
+    std::cout << "TEST 26 PASSED: Instrumentation counts stages " << (kInstrumented ? "(compiled in)" : "(compiled out)")
+              << std::endl;
+}
+
+// TEST 27: Clock policies → stamps from TSC, gateway or nowhere; sequence keeps arrival order
+void test_engine_clocks() {
+    auto nothing = [](const Trade&) {};
+
+    // TSC stamps land on the steady_clock timeline
+    MatchingEngine<MapPriceLevels, TscClock> tsc;
+    auto before = std::chrono::steady_clock::now();
+    tsc.process_order(make_order(1, OrderType::Limit, Side::Buy, 99.0, 5), nothing);
+    auto after = std::chrono::steady_clock::now();
+    auto stamped = tsc.book().find_order(1)->timestamp;
+    assert(stamped >= before - std::chrono::milliseconds(1) && stamped <= after + std::chrono::milliseconds(1));
+
+    // Gateway stamps are kept as given, in a batch too
+    MatchingEngine<MapPriceLevels, GatewayClock> gateway;
+    Order stamped_order = make_order(2, OrderType::Limit, Side::Sell, 101.0, 5);
+    stamped_order.timestamp = std::chrono::steady_clock::time_point(std::chrono::seconds(42));
+    gateway.process_order(stamped_order, nothing);
+    Order batch[2] = {make_order(3, OrderType::Limit, Side::Sell, 102.0, 1),
+                      make_order(4, OrderType::Limit, Side::Buy, 98.0, 1)};
+    batch[0].timestamp = std::chrono::steady_clock::time_point(std::chrono::seconds(43));
+    batch[1].timestamp = std::chrono::steady_clock::time_point(std::chrono::seconds(44));
+    gateway.process_batch(batch, 2, nothing);
+    assert(gateway.book().find_order(2)->timestamp.time_since_epoch() == std::chrono::seconds(42));
+    assert(gateway.book().find_order(4)->timestamp.time_since_epoch() == std::chrono::seconds(44));
+    assert(gateway.replace_order(2, 103.0, 5, nothing) == OrderStatus::Resting);
+    assert(gateway.book().find_order(2)->timestamp.time_since_epoch() == std::chrono::seconds(44)); // Latest seen
+
+    // No clock: FIFO still holds, and sequence records arrival order
+    MatchingEngine<TickLadderPriceLevels, NoClock> none;
+    for (uint64_t id = 1; id <= 3; id++) {
+        none.process_order(make_order(id, OrderType::Limit, Side::Sell, 100.01, 2), nothing);
+    }
+    assert(none.book().find_order(1)->timestamp == std::chrono::steady_clock::time_point{});
+    assert(none.book().find_order(1)->sequence < none.book().find_order(2)->sequence);
+    assert(none.replace_order(1, 100.01, 3, nothing) == OrderStatus::Resting); // More size: to the back
+    assert(none.book().find_order(1)->sequence > none.book().find_order(3)->sequence);
+    auto trades = none.process_order(make_order(9, OrderType::Market, Side::Buy, 0, 5));
+    assert(trades.size() == 3 && trades[0].sell_order_id == 2 && trades[2].sell_order_id == 1);
+
+    std::cout << "TEST 27 PASSED: Clock policies stamp as configured and sequence keeps arrival order" << std::endl;
+}
+
+// TEST 28: Occupancy bitmap → nearest set bit matches a linear scan; sparse ladder sweeps in order
+void test_occupancy_bitmap() {
+    const size_t n = 3 * 4096 + 77; // Several summary words, ragged tail
+    OccupancyBitmap bitmap(n);
+    std::vector<bool> reference(n, false);
+    assert(bitmap.find_next(0) == OccupancyBitmap::npos && bitmap.find_prev(n) == OccupancyBitmap::npos);
+
+    std::mt19937_64 rng(7);
+    for (int round = 0; round < 2000; round++) {
+        size_t i = rng() % n;
+        if (rng() % 3 == 0) {
+            bitmap.clear(i);
+            reference[i] = false;
+        } else if (round < 40 || rng() % 50 == 0) { // Stays sparse: long empty stretches
+            bitmap.set(i);
+            reference[i] = true;
+        }
+        size_t from = rng() % n;
+        size_t next = from;
+        while (next < n && !reference[next]) next++;
+        size_t prev = from + 1;
+        while (prev > 0 && !reference[prev - 1]) prev--;
+        assert(bitmap.find_next(from) == (next == n ? OccupancyBitmap::npos : next));
+        assert(bitmap.find_prev(from) == (prev == 0 ? OccupancyBitmap::npos : prev - 1));
+        assert(bitmap.test(i) == reference[i]);
+    }
+
+    // Ladder: bids thousands of ticks apart, swept by one market order
+    BookConfig config;
+    config.ladder_levels = 1 << 20;
+    config.reference_price = 5000.0;
+    MatchingEngine<TickLadderPriceLevels> engine(config);
+    const double prices[] = {5000.00, 4999.99, 4900.00, 4000.00, 1000.00};
+    uint64_t id = 1;
+    for (double price : prices) {
+        engine.process_order(make_order(id++, OrderType::Limit, Side::Buy, price, 1));
+    }
+    L2Level depth[8];
+    assert(engine.snapshot(Side::Buy, 8, depth) == 5);
+    for (size_t i = 0; i < 5; i++) {
+        assert(depth[i].price == prices[i]);
+    }
+    auto trades = engine.process_order(make_order(id++, OrderType::Market, Side::Sell, 0, 4));
+    assert(trades.size() == 4 && trades[3].price == 4000.00);
+    assert(engine.best_bid() == 1000.00);
+
+    std::cout << "TEST 28 PASSED: Occupancy bitmap search matches a scan; sparse sweeps find the next level" << std::endl;
+}
+
+// TEST 29: Hybrid store → same trades and depth as the map store while the window follows a drifting market
+void test_hybrid_levels() {
+    BookConfig config;
+    config.window_levels = 16; // Tiny, so levels migrate all the time
+    config.order_pool_capacity = 1 << 12;
+    MatchingEngine<HybridPriceLevels> hybrid(config);
+    MatchingEngine<MapPriceLevels> reference(config);
+
+    std::mt19937_64 rng(11);
+    std::vector<Trade> got, want;
+    std::vector<uint64_t> live;
+    double mid = 100.0;
+    double drift = 0;
+    uint64_t id = 1;
+    for (int step = 0; step < 20000; step++) {
+        mid += (static_cast<int>(rng() % 3) - 1) * 0.01; // Random walk, far beyond the window
+        drift = std::max(drift, std::abs(mid - 100.0));
+        uint64_t roll = rng() % 100;
+        if (roll < 55 || live.empty()) {
+            Side side = rng() % 2 ? Side::Buy : Side::Sell;
+            double offset = static_cast<double>(rng() % 40) * 0.01 - 0.05; // Some cross
+            double price = std::round((side == Side::Buy ? mid - offset : mid + offset) * 100) / 100;
+            Order order = make_order(id, OrderType::Limit, side, price, 1 + rng() % 20);
+            hybrid.process_order(order, [&](const Trade& t) { got.push_back(t); });
+            reference.process_order(order, [&](const Trade& t) { want.push_back(t); });
+            live.push_back(id++);
+        } else if (roll < 90) {
+            size_t pick = rng() % live.size();
+            assert(hybrid.cancel_order(live[pick]) == reference.cancel_order(live[pick]));
+            live[pick] = live.back();
+            live.pop_back();
+        } else {
+            Order order = make_order(id++, OrderType::Market, rng() % 2 ? Side::Buy : Side::Sell, 0, 1 + rng() % 60);
+            hybrid.process_order(order, [&](const Trade& t) { got.push_back(t); });
+            reference.process_order(order, [&](const Trade& t) { want.push_back(t); });
+        }
+        if (step % 97 == 0) {
+            for (Side side : {Side::Buy, Side::Sell}) {
+                L2Level a[64], b[64];
+                size_t n = hybrid.snapshot(side, 64, a);
+                assert(n == reference.snapshot(side, 64, b));
+                for (size_t i = 0; i < n; i++) {
+                    assert(a[i].price == b[i].price && a[i].quantity == b[i].quantity && a[i].order_count == b[i].order_count);
+                }
+            }
+        }
+    }
+    assert(got.size() == want.size() && !got.empty());
+    for (size_t i = 0; i < got.size(); i++) {
+        assert(got[i].buy_order_id == want[i].buy_order_id && got[i].sell_order_id == want[i].sell_order_id);
+        assert(got[i].quantity == want[i].quantity && got[i].price == want[i].price);
+    }
+    assert(hybrid.book().bid_levels() == reference.book().bid_levels());
+    assert(hybrid.book().ask_levels() == reference.book().ask_levels());
+    assert(drift > 0.5); // Well over the 16-tick window: levels had to migrate
+
+    std::cout << "TEST 29 PASSED: Hybrid store matches the map store as the window follows the market" << std::endl;
+}
+
+// TEST 30: Accounts → self-trade prevention in the match loop, exposure counted per fill, limits on entry
+void test_self_trade_and_exposure() {
+    auto order_for = [](uint64_t id, OrderType type, Side side, double price, uint32_t qty,
+                        uint32_t account, SelfTradePolicy stp = SelfTradePolicy::None) {
+        Order o = make_order(id, type, side, price, qty);
+        o.account = account;
+        o.stp = stp;
+        return o;
+    };
+    auto resting_book = [&](MatchingEngine<TickLadderPriceLevels>& engine) {
+        engine.process_order(order_for(1, OrderType::Limit, Side::Sell, 100.01, 5, 7));
+        engine.process_order(order_for(2, OrderType::Limit, Side::Sell, 100.01, 5, 8));
+    };
+    auto nothing = [](const Trade&) {};
+
+    // No policy: trades with itself like anyone else
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        auto trades = engine.process_order(order_for(3, OrderType::Market, Side::Buy, 0, 3, 7));
+        assert(trades.size() == 1 && trades[0].sell_order_id == 1);
+        assert(engine.exposure(7)->position == 0 && engine.exposure(7)->bought == 3 && engine.exposure(7)->sold == 3);
+    }
+    // Cancel newest: the incoming order stops at its own resting order
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        auto status = engine.process_order(
+            order_for(3, OrderType::Limit, Side::Buy, 100.01, 8, 7, SelfTradePolicy::CancelNewest), nothing);
+        assert(status == OrderStatus::Cancelled && !engine.book().find_order(3));
+        assert(engine.book().find_order(1)->quantity == 5 && engine.book().find_order(2)->quantity == 5);
+    }
+    // Cancel oldest: own order removed, matching continues behind it
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        std::vector<Trade> trades;
+        auto status = engine.process_order(
+            order_for(3, OrderType::Limit, Side::Buy, 100.01, 8, 7, SelfTradePolicy::CancelOldest),
+            [&](const Trade& t) { trades.push_back(t); });
+        assert(status == OrderStatus::Resting && !engine.book().find_order(1));
+        assert(trades.size() == 1 && trades[0].sell_order_id == 2 && trades[0].quantity == 5);
+        assert(engine.book().find_order(3)->quantity == 3);
+        assert(engine.exposure(7)->position == 5 && engine.exposure(8)->position == -5);
+    }
+    // Decrement both: no trade for the overlap, the rest keeps matching
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        std::vector<Trade> trades;
+        auto status = engine.process_order(
+            order_for(3, OrderType::Market, Side::Buy, 0, 7, 7, SelfTradePolicy::DecrementBoth),
+            [&](const Trade& t) { trades.push_back(t); });
+        assert(status == OrderStatus::Cancelled); // 5 of 7 removed by the policy
+        assert(trades.size() == 1 && trades[0].sell_order_id == 2 && trades[0].quantity == 2);
+        assert(!engine.book().find_order(1) && engine.book().find_order(2)->quantity == 3);
+        assert(engine.exposure(7)->bought == 2 && engine.exposure(7)->sold == 0);
+    }
+    // FOK with a policy counts only what it would trade with: kills rather
+    // than part-fills, and fills past its own orders under cancel oldest
+    for (SelfTradePolicy stp : {SelfTradePolicy::CancelNewest, SelfTradePolicy::DecrementBoth}) {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        Order fok = order_for(3, OrderType::Limit, Side::Buy, 100.01, 8, 8, stp); // #2 is its own
+        fok.tif = TimeInForce::FOK;
+        std::vector<Trade> trades;
+        auto status = engine.process_order(fok, [&](const Trade& t) { trades.push_back(t); });
+        assert(status == OrderStatus::Cancelled && trades.empty());
+        assert(engine.book().find_order(1)->quantity == 5 && engine.book().find_order(2)->quantity == 5);
+        Order market = order_for(4, OrderType::Market, Side::Buy, 0, 5, 7, stp); // #1 is its own
+        market.tif = TimeInForce::FOK;
+        assert(engine.process_order(market, nothing) == OrderStatus::Cancelled);
+        assert(engine.book().ask_quantity() == 10);
+    }
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        Order fok = order_for(3, OrderType::Limit, Side::Buy, 100.01, 6, 7, SelfTradePolicy::CancelOldest);
+        fok.tif = TimeInForce::FOK;
+        assert(engine.process_order(fok, nothing) == OrderStatus::Cancelled); // 5 of the 10 are its own
+        assert(engine.book().ask_quantity() == 10);
+        fok.quantity = 5;
+        assert(engine.process_order(fok, nothing) == OrderStatus::Filled);
+        assert(!engine.has_asks());
+    }
+    // Position limits are checked on entry; unknown accounts are refused
+    {
+        MatchingEngine<TickLadderPriceLevels> engine;
+        resting_book(engine);
+        assert(engine.set_position_limit(9, 4) && !engine.set_position_limit(0, 4));
+        assert(engine.process_order(order_for(3, OrderType::Market, Side::Buy, 0, 5, 9), nothing) ==
+               OrderStatus::Rejected);
+        assert(engine.process_order(order_for(4, OrderType::Market, Side::Buy, 0, 4, 9), nothing) ==
+               OrderStatus::Filled);
+        assert(engine.exposure(9)->position == 4 && engine.exposure(7)->position == -4);
+        assert(engine.process_order(order_for(5, OrderType::Limit, Side::Buy, 99.0, 1, 9), nothing) ==
+               OrderStatus::Rejected);
+        assert(engine.process_order(order_for(6, OrderType::Limit, Side::Sell, 101.0, 8, 9), nothing) ==
+               OrderStatus::Resting); // Down to -4
+        assert(engine.process_order(order_for(7, OrderType::Limit, Side::Buy, 99.0, 1, 100000), nothing) ==
+               OrderStatus::Rejected);
+        assert(!engine.exposure(0) && !engine.exposure(100000));
+
+        // A batch applies the same checks, even to a run at one level
+        MatchingEngine<TickLadderPriceLevels> batched;
+        resting_book(batched);
+        assert(batched.set_position_limit(9, 4));
+        Order run[4] = {order_for(10, OrderType::Limit, Side::Buy, 99.0, 3, 9),
+                        order_for(11, OrderType::Limit, Side::Buy, 99.0, 5, 9),      // Over the limit
+                        order_for(12, OrderType::Limit, Side::Buy, 99.0, 1, 100000), // Unknown
+                        order_for(13, OrderType::Limit, Side::Buy, 99.0, 4, 9)};
+        batched.process_batch(run, 4, nothing);
+        MatchingEngine<TickLadderPriceLevels> single;
+        resting_book(single);
+        assert(single.set_position_limit(9, 4));
+        for (const Order& order : run) single.process_order(order, nothing);
+        assert(batched.book().bid_count() == 2 && single.book().bid_count() == 2);
+        assert(!batched.book().find_order(11) && !batched.book().find_order(12));
+        assert(batched.book().bid_quantity() == single.book().bid_quantity());
+
+        // Accounts survive a snapshot
+        std::vector<uint8_t> image;
+        engine.save_snapshot(image);
+        MatchingEngine<TickLadderPriceLevels> restored;
+        assert(restored.restore_snapshot(image.data(), image.size()));
+        assert(restored.book().find_order(6)->account == 9);
+    }
+
+    std::cout << "TEST 30 PASSED: Self-trade prevention and exposure are applied inside matching" << std::endl;
+}
+
+// TEST 31: Mass cancel → one pass over an account's list or a price range, one L2 delta per level
+template <typename PriceLevels>
+void check_mass_cancel() {
+    BookConfig config;
+    config.publish_l2 = true;
+    MatchingEngine<PriceLevels> engine(config);
+    auto sink = [](const Trade&) {};
+    auto add = [&](uint64_t id, Side side, double price, uint32_t qty, uint32_t account) {
+        Order o = make_order(id, OrderType::Limit, side, price, qty);
+        o.account = account;
+        return engine.process_order(o, sink);
+    };
+    // Account 5 on three bid and two ask levels, interleaved with account 6
+    uint64_t id = 1;
+    for (double price : {99.0, 99.5, 99.9}) {
+        add(id++, Side::Buy, price, 10, 5);
+        add(id++, Side::Buy, price, 10, 6);
+        add(id++, Side::Buy, price, 10, 5);
+    }
+    for (double price : {100.1, 100.5}) {
+        add(id++, Side::Sell, price, 10, 5);
+        add(id++, Side::Sell, price, 10, 6);
+    }
+    Order stop = make_stop(id++, OrderType::Stop, Side::Sell, 98.0, 0, 1);
+    stop.account = 5;
+    assert(engine.process_order(stop, sink) == OrderStatus::Pending);
+
+    // Fills unlink from the account list too: account 5's first 100.1 ask goes
+    assert(engine.process_order(make_order(100, OrderType::Market, Side::Buy, 0, 10), sink) ==
+           OrderStatus::Filled);
+    engine.drain_deltas([](const L2Delta&) {});
+
+    // Account 5's bids only: 6 orders across 3 levels, 3 deltas
+    std::vector<uint64_t> cancelled;
+    MassCancelFilter bids;
+    bids.account = 5;
+    bids.side = Side::Buy;
+    assert(engine.mass_cancel(bids, [&](const Order& o) { cancelled.push_back(o.id); }) == 6);
+    std::sort(cancelled.begin(), cancelled.end());
+    assert((cancelled == std::vector<uint64_t>{1, 3, 4, 6, 7, 9}));
+    std::vector<L2Delta> deltas;
+    engine.drain_deltas([&](const L2Delta& d) { deltas.push_back(d); });
+    assert(deltas.size() == 3);
+    for (const L2Delta& d : deltas) {
+        assert(d.side == Side::Buy && d.action == LevelAction::Change && d.quantity == 10 && d.order_count == 1);
+    }
+    assert(engine.book().bid_count() == 3 && engine.book().bid_levels() == 3 && engine.book().bid_quantity() == 30);
+    assert(engine.book().ask_count() == 3 && engine.pending_stops() == 1);
+
+    // Survives a snapshot: the restored book relinks account lists
+    std::vector<uint8_t> image;
+    engine.save_snapshot(image);
+    MatchingEngine<PriceLevels> restored(config);
+    assert(restored.restore_snapshot(image.data(), image.size()));
+    MassCancelFilter account6;
+    account6.account = 6;
+    assert(restored.mass_cancel(account6) == 5);
+    assert(!restored.has_bids() && restored.book().ask_count() == 1);
+
+    // Everything else of account 5: the 100.5 ask and the stop
+    MassCancelFilter rest;
+    rest.account = 5;
+    assert(engine.mass_cancel(rest) == 2);
+    assert(engine.pending_stops() == 0 && engine.book().ask_count() == 2);
+    assert(engine.mass_cancel(rest) == 0);
+
+    // No account: a price range on both sides empties whole levels, each
+    // emitting one Delete
+    engine.drain_deltas([](const L2Delta&) {});
+    MassCancelFilter range;
+    range.min_price = 99.5;
+    range.max_price = 100.2;
+    assert(engine.mass_cancel(range) == 3);
+    deltas.clear();
+    engine.drain_deltas([&](const L2Delta& d) { deltas.push_back(d); });
+    assert(deltas.size() == 3);
+    for (const L2Delta& d : deltas) assert(d.action == LevelAction::Delete);
+    assert(*engine.best_bid() == 99.0 && *engine.best_ask() == 100.5);
+    assert(engine.book().bid_count() == 1 && engine.book().ask_count() == 1);
+
+    // Levels and lists stay usable afterwards
+    add(200, Side::Buy, 99.9, 4, 6);
+    assert(engine.book().find_order(200) && engine.book().level_quantity(Side::Buy, 99.9) == 4);
+    assert(engine.mass_cancel(account6) == 3 && engine.book().bid_count() == 0 && engine.book().ask_count() == 0);
+
+    // The book refuses accounts it has no list for
+    OrderBook<PriceLevels> book(config);
+    Order unknown = make_order(201, OrderType::Limit, Side::Buy, 99.0, 1);
+    unknown.account = config.max_accounts;
+    assert(!book.add_order(unknown) && book.bid_count() == 0);
+}
+
+void test_mass_cancel() {
+    check_mass_cancel<MapPriceLevels>();
+    check_mass_cancel<TickLadderPriceLevels>();
+    check_mass_cancel<HybridPriceLevels>();
+    std::cout << "TEST 31 PASSED: Mass cancel unlinks an account or a price range in one pass" << std::endl;
+}
+
+// TEST 32: Auction → orders rest crossed, one uncross at the max-volume price
+template <typename PriceLevels>
+void check_random_auctions() {
+    std::mt19937_64 rng(32);
+    for (int round = 0; round < 50; round++) {
+        MatchingEngine<PriceLevels> engine;
+        engine.begin_auction();
+        std::map<double, uint64_t> bids, asks;
+        uint64_t id = 1;
+        int orders = 1 + static_cast<int>(rng() % 60);
+        for (int i = 0; i < orders; i++) {
+            Side side = rng() % 2 ? Side::Buy : Side::Sell;
+            double price = 99.0 + 0.01 * static_cast<double>(rng() % 200);
+            price = std::round(price * 100) / 100;
+            uint32_t qty = 1 + static_cast<uint32_t>(rng() % 50);
+            assert(engine.process_order(make_order(id++, OrderType::Limit, side, price, qty), [](const Trade&) {}) ==
+                   OrderStatus::Resting);
+            (side == Side::Buy ? bids : asks)[price] += qty;
+        }
+
+        // Brute force over every price with a level
+        std::set<double> prices;
+        for (auto& [p, q] : bids) prices.insert(p);
+        for (auto& [p, q] : asks) prices.insert(p);
+        double mid = bids.empty() || asks.empty() ? 0 : (bids.rbegin()->first + asks.begin()->first) / 2;
+        std::optional<std::tuple<uint64_t, uint64_t, double, double>> best; // volume, surplus, distance, price
+        for (double p : prices) {
+            uint64_t demand = 0, supply = 0;
+            for (auto& [bp, q] : bids) if (bp >= p) demand += q;
+            for (auto& [ap, q] : asks) if (ap <= p) supply += q;
+            uint64_t volume = std::min(demand, supply);
+            if (volume == 0) continue;
+            auto candidate = std::make_tuple(volume, std::max(demand, supply) - volume, std::fabs(p - mid), p);
+            if (!best || std::get<0>(candidate) > std::get<0>(*best) ||
+                (std::get<0>(candidate) == std::get<0>(*best) &&
+                 std::make_tuple(std::get<1>(candidate), std::get<2>(candidate), p) <
+                     std::make_tuple(std::get<1>(*best), std::get<2>(*best), std::get<3>(*best)))) {
+                best = candidate;
+            }
+        }
+
+        auto indicative = engine.indicative_uncross();
+        assert(indicative.has_value() == best.has_value());
+        uint64_t traded = 0;
+        auto result = engine.uncross([&](const Trade& t) {
+            assert(t.price == indicative->price);
+            traded += t.quantity;
+        });
+        assert(!engine.in_auction());
+        if (!best) {
+            assert(!result && traded == 0);
+            continue;
+        }
+        assert(std::fabs(indicative->price - std::get<3>(*best)) < 1e-9);
+        assert(indicative->volume == std::get<0>(*best) && indicative->surplus == std::get<1>(*best));
+        assert(result->volume == indicative->volume && traded == result->volume);
+        assert(!engine.best_bid() || !engine.best_ask() || *engine.best_bid() < *engine.best_ask());
+    }
+}
+
+void test_auction() {
+    // Prefix scan: SIMD blocks plus a scalar tail
+    std::mt19937_64 rng(7);
+    for (size_t n = 0; n < 40; n++) {
+        std::vector<uint64_t> v(n), want(n);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            v[i] = rng() % 1000;
+            want[i] = sum += v[i];
+        }
+        inclusive_scan(v.data(), n);
+        assert(v == want);
+    }
+
+    MatchingEngine<TickLadderPriceLevels> engine;
+    std::vector<Trade> trades;
+    auto sink = [&](const Trade& t) { trades.push_back(t); };
+    engine.begin_auction();
+    assert(engine.in_auction() && !engine.indicative_uncross());
+    engine.process_order(make_order(1, OrderType::Limit, Side::Buy, 100.0, 10), sink);
+    engine.process_order(make_order(2, OrderType::Limit, Side::Buy, 99.5, 20), sink);
+    engine.process_order(make_order(3, OrderType::Limit, Side::Buy, 99.0, 30), sink);
+    engine.process_order(make_order(4, OrderType::Limit, Side::Sell, 98.5, 15), sink);
+    engine.process_order(make_order(5, OrderType::Limit, Side::Sell, 99.0, 10), sink);
+    engine.process_order(make_order(6, OrderType::Limit, Side::Sell, 99.5, 25), sink);
+    engine.process_order(make_order(7, OrderType::Limit, Side::Sell, 100.5, 5), sink);
+    assert(trades.empty() && *engine.best_bid() == 100.0 && *engine.best_ask() == 98.5);
+
+    // Only orders that can wait for the uncross are accepted
+    assert(engine.process_order(make_order(8, OrderType::Market, Side::Buy, 0, 5), sink) == OrderStatus::Rejected);
+    Order ioc = make_order(9, OrderType::Limit, Side::Buy, 101.0, 5);
+    ioc.tif = TimeInForce::IOC;
+    assert(engine.process_order(ioc, sink) == OrderStatus::Rejected);
+    // A replace re-prices without trading
+    assert(engine.replace_order(7, 98.5, 5, sink) == OrderStatus::Resting && trades.empty());
+    assert(engine.replace_order(7, 100.5, 5, sink) == OrderStatus::Resting);
+
+    // Supply 15/25/50/50 vs demand 60/60/30/10 at 98.5/99.0/99.5/100.0
+    auto indicative = engine.indicative_uncross();
+    assert(indicative && indicative->price == 99.5 && indicative->volume == 30 && indicative->surplus == 20);
+    auto result = engine.uncross(sink);
+    assert(result && result->price == 99.5 && result->volume == 30 && result->surplus == 20);
+    uint64_t volume = 0;
+    for (const Trade& t : trades) {
+        assert(t.price == 99.5);
+        volume += t.quantity;
+    }
+    assert(volume == 30 && trades.front().buy_order_id == 1 && trades.front().sell_order_id == 4);
+    assert(!engine.book().find_order(1) && !engine.book().find_order(2) && !engine.book().find_order(4) &&
+           !engine.book().find_order(5) && engine.book().find_order(6)->quantity == 20);
+    assert(*engine.best_bid() == 99.0 && *engine.best_ask() == 99.5 && *engine.last_trade_price() == 99.5);
+
+    // Continuous matching resumes
+    trades.clear();
+    assert(engine.process_order(make_order(10, OrderType::Limit, Side::Buy, 99.5, 5), sink) == OrderStatus::Filled);
+    assert(trades.size() == 1 && trades[0].sell_order_id == 6);
+
+    check_random_auctions<MapPriceLevels>();
+    check_random_auctions<TickLadderPriceLevels>();
+    check_random_auctions<HybridPriceLevels>();
+
+    std::cout << "TEST 32 PASSED: Auction orders rest crossed and uncross at the max-volume price" << std::endl;
+}
+
+// TEST 33: Arena → book containers draw from one pre-faulted region, same results as the heap
+template <typename Engine>
+std::vector<Trade> run_arena_flow(Engine& engine, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Trade> trades;
+    auto sink = [&](const Trade& t) { trades.push_back(t); };
+    uint64_t id = 1;
+    for (int step = 0; step < 5000; step++) {
+        Side side = rng() % 2 ? Side::Buy : Side::Sell;
+        double price = 100.0 + 0.01 * (static_cast<double>(rng() % 400) - 200.0);
+        price = std::round(price * 100) / 100;
+        uint32_t qty = 1 + static_cast<uint32_t>(rng() % 100);
+        switch (rng() % 10) {
+        case 0:
+            engine.process_order(make_order(id++, OrderType::Market, side, 0, qty), sink);
+            break;
+        case 1:
+        case 2:
+            engine.cancel_order(1 + rng() % id);
+            break;
+        case 3:
+            engine.replace_order(1 + rng() % id, price, qty, sink);
+            break;
+        case 4:
+            engine.process_order(make_stop(id++, OrderType::Stop, side, price, 0, qty), sink);
+            break;
+        default:
+            engine.process_order(make_order(id++, OrderType::Limit, side, price, qty), sink);
+        }
+    }
+    return trades;
+}
+
+template <typename PriceLevels>
+void check_arena_engine() {
+    BookConfig heap;
+    BookConfig arena = heap;
+    arena.arena_bytes = 32 << 20;
+    MatchingEngine<PriceLevels> on_heap(heap);
+    MatchingEngine<PriceLevels> in_arena(arena);
+    auto want = run_arena_flow(on_heap, 33);
+    auto got = run_arena_flow(in_arena, 33);
+    assert(got.size() == want.size() && !got.empty());
+    for (size_t i = 0; i < got.size(); i++) {
+        assert(got[i].buy_order_id == want[i].buy_order_id && got[i].sell_order_id == want[i].sell_order_id);
+        assert(got[i].price == want[i].price && got[i].quantity == want[i].quantity);
+    }
+    assert(in_arena.best_bid() == on_heap.best_bid() && in_arena.best_ask() == on_heap.best_ask());
+    ArenaStats stats = in_arena.arena_stats();
+    assert(stats.capacity >= arena.arena_bytes && stats.overflow == 0 && stats.allocations > 0);
+    assert(stats.reserved > 0 && stats.live > 0 && stats.peak >= stats.live);
+    assert(on_heap.arena_stats().capacity == 0);
+
+    // Too small a region overflows to the heap and keeps working
+    BookConfig tiny = heap;
+    tiny.arena_bytes = 64 << 10;
+    tiny.huge_pages = false;
+    MatchingEngine<PriceLevels> squeezed(tiny);
+    assert(run_arena_flow(squeezed, 33).size() == want.size() && squeezed.arena_stats().overflow > 0);
+}
+
+void test_arena() {
+    Arena arena(1 << 20, false);
+    assert(arena.stats().capacity == 1 << 20 && !arena.stats().huge_pages);
+    void* p = arena.allocate(100, 8);
+    assert(arena.owns(p) && arena.stats().live == 112);
+    arena.deallocate(p, 100, 8);
+    assert(arena.allocate(100, 8) == p); // Recycled by size class
+    void* aligned = arena.allocate(32, 32);
+    assert(reinterpret_cast<uintptr_t>(aligned) % 32 == 0);
+    void* large = arena.allocate(100000, 64);
+    assert(reinterpret_cast<uintptr_t>(large) % 64 == 0);
+    arena.deallocate(large, 100000, 64);
+    assert(arena.allocate(100000, 64) == large);
+    void* outside = arena.allocate(2 << 20, 8); // Bigger than the region
+    assert(!arena.owns(outside) && arena.stats().overflow == 1);
+    arena.deallocate(outside, 2 << 20, 8);
+
+    // Containers of an engine built on a caller's arena; engines stay movable
+    Arena shared(8 << 20);
+    BookConfig config;
+    config.arena = &shared;
+    std::vector<MatchingEngine<TickLadderPriceLevels>> engines;
+    engines.emplace_back(config);
+    size_t before = shared.stats().allocations;
+    assert(before > 0 && engines[0].arena_stats().allocations == before);
+    engines.emplace_back(config);
+    engines[0].process_order(make_order(1, OrderType::Limit, Side::Buy, 99.0, 5), [](const Trade&) {});
+    assert(*engines[0].best_bid() == 99.0 && shared.stats().allocations > before);
+
+    // Sharded engines each own an arena built on their shard's thread
+    using Sharded = MultiSymbolEngine<TickLadderPriceLevels>;
+    Sharded::Config sharded;
+    sharded.num_shards = 2;
+    sharded.num_symbols = 4;
+    sharded.pin_threads = false;
+    sharded.book.arena_bytes = 1 << 20;
+    sharded.book.huge_pages = false;
+    sharded.book.arena = &shared; // Ignored: not safe to share across threads
+    size_t shared_before = shared.stats().allocations;
+    Sharded symbols(sharded, [](uint32_t, const Trade&) {});
+    for (uint32_t sym = 0; sym < 4; sym++) {
+        symbols.submit({CommandType::NewOrder, sym, make_order(1, OrderType::Limit, Side::Sell, 100.0, 5)});
+    }
+    symbols.stop();
+    for (uint32_t sym = 0; sym < 4; sym++) {
+        assert(symbols.engine(sym).arena_stats().capacity == 1 << 20 && symbols.engine(sym).has_asks());
+    }
+    assert(shared.stats().allocations == shared_before);
+
+    check_arena_engine<MapPriceLevels>();
+    check_arena_engine<TickLadderPriceLevels>();
+    check_arena_engine<HybridPriceLevels>();
+
+    std::cout << "TEST 33 PASSED: Engine containers allocate from a pre-faulted arena" << std::endl;
+}
+
+// TEST 34: Replicas → same sequenced stream, same rolling hash at every sequence
+using Replica = MatchingEngine<TickLadderPriceLevels, GatewayClock>;
+
+std::vector<Command> sequenced_stream(size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Command> stream;
+    auto start = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+    uint64_t id = 1;
+    for (size_t i = 0; i < count; i++) {
+        Side side = rng() % 2 ? Side::Buy : Side::Sell;
+        double price = std::round((100.0 + 0.01 * (static_cast<double>(rng() % 200) - 100.0)) * 100) / 100;
+        uint32_t qty = 1 + static_cast<uint32_t>(rng() % 50);
+        Command command{CommandType::NewOrder, 0, make_order(id, OrderType::Limit, side, price, qty)};
+        switch (rng() % 8) {
+        case 0:
+            command.type = CommandType::Cancel;
+            command.order.id = 1 + rng() % id;
+            break;
+        case 1:
+            command.type = CommandType::Replace;
+            command.order.id = 1 + rng() % id;
+            break;
+        case 2:
+            command.order = make_order(id++, OrderType::Market, side, 0, qty);
+            break;
+        case 3:
+            command.order = make_stop(id++, OrderType::Stop, side, price, 0, qty);
+            break;
+        case 4:
+            command.order.display_quantity = 5; // Iceberg
+            id++;
+            break;
+        default:
+            id++;
+        }
+        command.sequence = i + 1;
+        command.order.timestamp = start + std::chrono::microseconds(i);
+        stream.push_back(command);
+    }
+    return stream;
+}
+
+void test_deterministic_replicas() {
+    BookConfig config;
+    config.state_hash = true;
+    const size_t count = 20000;
+    std::vector<Command> stream = sequenced_stream(count, 34);
+
+    // A sequencer thread publishes the stream to one ring per replica; each
+    // replica drains with its own batch size and records its rolling hash
+    static SpscRing<Command, 1024> rings[2];
+    std::thread sequencer([&]() {
+        for (const Command& command : stream) {
+            for (auto& ring : rings) {
+                while (!ring.try_push(command)) std::this_thread::yield();
+            }
+        }
+    });
+    Replica replicas[2] = {Replica(config), Replica(config)};
+    std::map<uint64_t, uint64_t> hashes[2]; // Sequence -> rolling hash at a batch end
+    const size_t batch[2] = {1, 61};
+    Command buffer[64];
+    auto sink = [](const Trade&) {};
+    while (replicas[0].next_sequence() <= count || replicas[1].next_sequence() <= count) {
+        for (int r = 0; r < 2; r++) {
+            size_t n = rings[r].pop_batch(buffer, batch[r]);
+            if (n == 0) continue;
+            assert(replicas[r].apply_sequenced(buffer, n, sink) == n);
+            hashes[r][replicas[r].next_sequence() - 1] = replicas[r].rolling_hash();
+        }
+    }
+    sequencer.join();
+
+    // Agree wherever both stopped at the same sequence number
+    assert(hashes[0].size() == count);
+    for (const auto& [sequence, hash] : hashes[1]) assert(hashes[0].at(sequence) == hash);
+    assert(replicas[0].state_hash() == replicas[1].state_hash());
+    assert(replicas[0].has_bids() && replicas[0].has_asks());
+    std::vector<uint8_t> snapshots[2];
+    for (int r = 0; r < 2; r++) replicas[r].save_snapshot(snapshots[r]);
+    assert(snapshots[0] == snapshots[1]);
+    uint64_t book_hash = replicas[1].book().state_hash();
+    uint64_t engine_hash = replicas[1].state_hash();
+
+    // Redelivery is skipped, a gap stops the batch
+    Replica& replica = replicas[0];
+    uint64_t rolling = replica.rolling_hash();
+    uint64_t state = replica.state_hash();
+    assert(replica.apply_sequenced(stream.data() + count - 3, 3, sink) == 3);
+    assert(replica.rolling_hash() == rolling && replica.next_sequence() == count + 1);
+    Command next{CommandType::NewOrder, 0, make_order(900001, OrderType::Limit, Side::Buy, 90.0, 7)};
+    next.sequence = count + 2;
+    next.order.sequence = count + 1; // Book-owned, not the input sequence
+    next.order.timestamp = stream.back().order.timestamp;
+    assert(replica.apply_sequenced(&next, 1, sink) == 0 && replica.next_sequence() == count + 1);
+
+    // Any difference in input shows up in both hashes
+    next.sequence = count + 1;
+    Command other = next;
+    other.order.quantity = 8;
+    assert(replicas[0].apply_sequenced(&next, 1, sink) == 1);
+    assert(replicas[1].apply_sequenced(&other, 1, sink) == 1);
+    assert(replicas[0].state_hash() != state);
+    assert(replicas[0].rolling_hash() != replicas[1].rolling_hash());
+    assert(replicas[0].state_hash() != replicas[1].state_hash());
+    next.type = CommandType::Cancel;
+    next.sequence = count + 2;
+    assert(replicas[0].apply_sequenced(&next, 1, sink) == 1 && replicas[0].state_hash() == state);
+
+    // The image reproduces the book and engine hashes
+    Replica restored(config);
+    assert(restored.restore_snapshot(snapshots[1].data(), snapshots[1].size()));
+    assert(restored.book().state_hash() == book_hash && restored.state_hash() == engine_hash);
+
+    // A standby restored from a full engine snapshot mid-stream is
+    // identical at once and stays so
+    {
+        Replica primary(config);
+        size_t half = count / 2;
+        assert(primary.apply_sequenced(stream.data(), half, sink) == half);
+        assert(primary.pending_stops() > 0 && primary.last_trade_price());
+        std::vector<uint8_t> image;
+        primary.save_snapshot(image, 77);
+        Replica standby(config);
+        assert(standby.restore_snapshot(image.data(), image.size()));
+        assert(standby.state_hash() == primary.state_hash() && standby.rolling_hash() == primary.rolling_hash());
+        assert(standby.next_sequence() == half + 1 && standby.pending_stops() == primary.pending_stops());
+        assert(primary.apply_sequenced(stream.data() + half, count - half, sink) == count - half);
+        assert(standby.apply_sequenced(stream.data() + half, count - half, sink) == count - half);
+        assert(standby.state_hash() == primary.state_hash() && standby.rolling_hash() == primary.rolling_hash());
+        assert(standby.rolling_hash() == hashes[0].at(count));
+        assert(!standby.restore_snapshot(image.data(), image.size())); // Not empty
+        Replica damaged(config);
+        assert(!damaged.restore_snapshot(image.data(), image.size() - 1));
+    }
+
+    // The newest order cancelled before the snapshot, a pending stop, a
+    // last price and an exposure limit all come across
+    {
+        uint64_t sequence = 0;
+        auto sequenced = [&](CommandType type, Order order) {
+            Command command{type, 0, order};
+            command.sequence = ++sequence;
+            command.order.timestamp = std::chrono::steady_clock::time_point{} + std::chrono::seconds(sequence);
+            return command;
+        };
+        Order stop = make_stop(6, OrderType::Stop, Side::Sell, 99.0, 0, 2);
+        std::vector<Command> setup = {
+            sequenced(CommandType::NewOrder, make_order(1, OrderType::Limit, Side::Sell, 100.0, 5)),
+            sequenced(CommandType::NewOrder, make_order(2, OrderType::Limit, Side::Buy, 99.0, 5)),
+            sequenced(CommandType::NewOrder, make_order(3, OrderType::Limit, Side::Buy, 98.0, 5)),
+            sequenced(CommandType::Cancel, make_order(3, OrderType::Limit, Side::Buy, 0, 0)),
+            sequenced(CommandType::NewOrder, make_order(5, OrderType::Market, Side::Buy, 0, 1)),
+            sequenced(CommandType::NewOrder, stop)};
+        Replica primary(config);
+        assert(primary.set_position_limit(9, 3));
+        assert(primary.apply_sequenced(setup.data(), setup.size(), sink) == setup.size());
+        std::vector<uint8_t> image;
+        primary.save_snapshot(image);
+        Replica standby(config);
+        assert(standby.restore_snapshot(image.data(), image.size()));
+        assert(standby.state_hash() == primary.state_hash() && standby.last_trade_price() == 100.0);
+        assert(standby.pending_stops() == 1 && standby.exposure(9)->position_limit == 3);
+
+        Order limited = make_order(8, OrderType::Limit, Side::Buy, 97.0, 4);
+        limited.account = 9; // Over its limit in both
+        std::vector<Command> tail = {
+            sequenced(CommandType::NewOrder, make_order(7, OrderType::Limit, Side::Buy, 98.0, 5)),
+            sequenced(CommandType::NewOrder, limited),
+            sequenced(CommandType::NewOrder, make_order(9, OrderType::Market, Side::Sell, 0, 5))}; // Fires #6
+        for (Replica* copy : {&primary, &standby}) {
+            assert(copy->apply_sequenced(tail.data(), tail.size(), sink) == tail.size());
+            assert(copy->pending_stops() == 0 && !copy->book().find_order(8));
+        }
+        assert(standby.book().find_order(7)->sequence == primary.book().find_order(7)->sequence);
+        assert(standby.state_hash() == primary.state_hash() && standby.rolling_hash() == primary.rolling_hash());
+    }
+
+    // Pending stops hash by queue position and every field: the same two
+    // stops in the guarded_first FIFO order, or with another self-trade policy,
+    // give a different digest
+    {
+        Order first = make_stop(21, OrderType::Stop, Side::Sell, 95.0, 0, 2);
+        Order second = make_stop(22, OrderType::Stop, Side::Sell, 95.0, 0, 2);
+        first.account = second.account = 4;
+        Order guarded = first;
+        guarded.stp = SelfTradePolicy::CancelNewest;
+        Replica forward(config), backward(config), guarded_first(config);
+        forward.process_order(first);
+        forward.process_order(second);
+        backward.process_order(second);
+        backward.process_order(first);
+        guarded_first.process_order(guarded);
+        guarded_first.process_order(second);
+        assert(forward.pending_stops() == 2 && backward.pending_stops() == 2 && guarded_first.pending_stops() == 2);
+        assert(forward.state_hash() != backward.state_hash());
+        assert(forward.state_hash() != guarded_first.state_hash());
+
+        // The position survives a snapshot
+        std::vector<uint8_t> image;
+        backward.save_snapshot(image);
+        Replica restored_stops(config);
+        assert(restored_stops.restore_snapshot(image.data(), image.size()));
+        assert(restored_stops.state_hash() == backward.state_hash());
+        restored_stops.process_order(make_stop(23, OrderType::Stop, Side::Sell, 95.0, 0, 1));
+        backward.process_order(make_stop(23, OrderType::Stop, Side::Sell, 95.0, 0, 1));
+        assert(restored_stops.state_hash() == backward.state_hash());
+    }
+
+    // Refilling an iceberg slice takes a new sequence (it lost priority)
+    MatchingEngine<MapPriceLevels> engine(config);
+    Order iceberg = make_order(1, OrderType::Limit, Side::Sell, 100.0, 20);
+    iceberg.display_quantity = 5;
+    engine.process_order(iceberg);
+    engine.process_order(make_order(2, OrderType::Limit, Side::Sell, 100.0, 5));
+    uint64_t before = engine.book().state_hash();
+    uint64_t first = engine.book().find_order(1)->sequence;
+    engine.process_order(make_order(3, OrderType::Market, Side::Buy, 0, 5));
+    assert(engine.book().find_order(1)->sequence > engine.book().find_order(2)->sequence);
+    assert(engine.book().find_order(1)->sequence != first && engine.book().state_hash() != before);
+
+    std::cout << "TEST 34 PASSED: Replicas fed one sequenced stream stay bit-identical" << std::endl;
+}
+
 int main() {
     std::cout << "Running unit tests...\n" << std::endl;
     
@@ -137,7 +2196,36 @@ int main() {
     test_partial_fill();
     test_market_order_sweeps();
     test_market_order_empty_book();
+    test_tick_ladder_matching();
+    test_tick_ladder_rejects_bad_prices();
+    test_order_pool_occupancy();
+    test_order_index();
+    test_trade_sinks();
+    test_multi_level_sweep();
+    test_level_aggregates();
+    test_l2_deltas();
+    test_multi_symbol_engine();
+    test_engine_pipeline();
+    test_process_batch();
+    test_packed_resting_orders();
+    test_binary_protocol();
+    test_journal_replay();
+    test_snapshot_restore();
+    test_replace_order();
+    test_iceberg_orders();
+    test_time_in_force();
+    test_stop_orders();
+    test_histogram_and_workload();
+    test_instrumentation();
+    test_engine_clocks();
+    test_occupancy_bitmap();
+    test_hybrid_levels();
+    test_self_trade_and_exposure();
+    test_mass_cancel();
+    test_auction();
+    test_arena();
+    test_deterministic_replicas();
     
-    std::cout << "\n=== ALL 5 TESTS PASSED ===" << std::endl;
+    std::cout << "\n=== ALL 34 TESTS PASSED ===" << std::endl;
     return 0;
 }
@@ -0,0 +1,94 @@
+#ifndef TRADE_SINK_HPP
+#define TRADE_SINK_HPP
+
+#include "order.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <type_traits>
+#include <utility>
+
+namespace orderbook {
+
+// Represents a completed trade
+struct Trade {
+    uint64_t buy_order_id;
+    uint64_t sell_order_id;
+    double price;
+    uint32_t quantity;
+};
+
+// Trade sinks receive fills from MatchingEngine::process_order(order, sink).
+// Any callable accepting (const Trade&) works, e.g. a lambda forwarding to a
+// publisher. The two below store fills without touching the heap.
+//
+// A sink that also has on_triggered(const Order& stop, OrderStatus status,
+// uint32_t executed) hears how each stop the engine triggers on its behalf
+// came out, once the stop has run: stop as it was released (type already
+// Market / Limit), its status, and the quantity it traded.
+template <typename Sink, typename = void>
+struct HearsTriggers : std::false_type {};
+
+template <typename Sink>
+struct HearsTriggers<Sink, std::void_t<decltype(std::declval<Sink&>().on_triggered(
+                               std::declval<const Order&>(), OrderStatus{}, uint32_t{}))>>
+    : std::true_type {};
+
+// Writes into caller-owned storage. Fills beyond capacity are counted in
+// dropped rather than written.
+struct TradeSpanSink {
+    Trade* data;
+    size_t capacity;
+    size_t count = 0;
+    size_t dropped = 0;
+
+    TradeSpanSink(Trade* buffer, size_t size) : data(buffer), capacity(size) {}
+
+    void operator()(const Trade& trade) {
+        if (count < capacity) {
+            data[count++] = trade;
+        } else {
+            dropped++;
+        }
+    }
+
+    void clear() { count = dropped = 0; }
+};
+
+// Fixed-capacity FIFO ring, drained by the consumer with pop().
+// N must be a power of two. Fills arriving while full are counted in dropped.
+template <size_t N>
+class TradeRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "TradeRing size must be a power of two");
+
+public:
+    void operator()(const Trade& trade) {
+        if (tail_ - head_ == N) {
+            dropped_++;
+            return;
+        }
+        trades_[tail_++ & (N - 1)] = trade;
+    }
+
+    bool pop(Trade& out) {
+        if (head_ == tail_) {
+            return false;
+        }
+        out = trades_[head_++ & (N - 1)];
+        return true;
+    }
+
+    size_t size() const { return tail_ - head_; }
+    bool empty() const { return head_ == tail_; }
+    size_t dropped() const { return dropped_; }
+
+private:
+    std::array<Trade, N> trades_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    size_t dropped_ = 0;
+};
+
+} // namespace orderbook
+
+#endif // TRADE_SINK_HPP
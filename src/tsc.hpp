@@ -0,0 +1,77 @@
+#ifndef TSC_HPP
+#define TSC_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace orderbook {
+
+// Raw cycle counter: invariant TSC on x86, the generic timer on arm64,
+// steady_clock nanoseconds elsewhere. Reads are ordered against
+// surrounding loads (lfence), not serializing, so a read costs tens of
+// cycles rather than a clock_gettime call.
+inline uint64_t tsc_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#elif defined(__aarch64__)
+    uint64_t t;
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r"(t) :: "memory");
+    return t;
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Converts counter ticks to nanoseconds and knows the cost of one
+// back-to-back pair of reads, which is subtracted from every measurement
+struct TscTimer {
+    double ns_per_tick = 1.0;
+    uint64_t overhead_ticks = 0;
+
+    // Measure the counter rate against steady_clock over window, and the
+    // minimum cost of timing an empty region
+    static TscTimer calibrate(std::chrono::milliseconds window = std::chrono::milliseconds(50)) {
+        TscTimer timer;
+        auto wall_start = std::chrono::steady_clock::now();
+        uint64_t tsc_start = tsc_now();
+        while (std::chrono::steady_clock::now() - wall_start < window) {
+        }
+        uint64_t tsc_end = tsc_now();
+        auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - wall_start).count();
+        if (tsc_end > tsc_start) {
+            timer.ns_per_tick = static_cast<double>(wall_ns) / static_cast<double>(tsc_end - tsc_start);
+        }
+
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 10000; i++) {
+            uint64_t a = tsc_now();
+            uint64_t b = tsc_now();
+            best = std::min(best, b - a);
+        }
+        timer.overhead_ticks = best;
+        return timer;
+    }
+
+    // Nanoseconds between two reads, timer overhead removed
+    uint64_t elapsed_ns(uint64_t start, uint64_t end) const {
+        uint64_t ticks = end - start;
+        ticks = ticks > overhead_ticks ? ticks - overhead_ticks : 0;
+        return static_cast<uint64_t>(static_cast<double>(ticks) * ns_per_tick + 0.5);
+    }
+
+    double to_ns(uint64_t ticks) const { return static_cast<double>(ticks) * ns_per_tick; }
+};
+
+} // namespace orderbook
+
+#endif // TSC_HPP
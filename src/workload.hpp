@@ -0,0 +1,139 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include "command.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace orderbook {
+
+// Synthetic order flow for benchmarks: a deep pre-populated book followed by
+// a stream of adds, cancels and aggressive orders.
+//
+// Passive prices are drawn Zipfian by distance (in ticks) from the touch,
+// so activity clusters near the inside like a real book. Cancels target a
+// random live passive order. Aggressive orders are market orders sized to
+// take a few resting orders. Arrivals are a Poisson process: inter-arrival
+// gaps are exponential with mean 1 / arrival_rate.
+struct WorkloadConfig {
+    size_t operations = 1000000;  // Events after pre-population
+    size_t book_depth = 100000;   // Resting orders placed before the stream
+    double add_ratio = 0.60;      // Remaining share after add + cancel is aggressive
+    double cancel_ratio = 0.35;
+    uint32_t price_levels = 200;  // Ticks from the touch an add can land on (per side)
+    double zipf_exponent = 1.1;   // Higher clusters adds nearer the touch
+    double mid_price = 100.0;
+    double tick_size = 0.01;
+    uint32_t max_quantity = 100;
+    uint32_t aggressive_multiplier = 3; // Aggressive size in passive-order multiples
+    double arrival_rate = 1e6;    // Mean events per second (Poisson)
+    uint64_t seed = 42;
+};
+
+struct Workload {
+    std::vector<Command> setup;       // Pre-population (adds only)
+    std::vector<Command> events;      // Measured stream
+    std::vector<uint64_t> arrival_ns; // Arrival time of each event from stream start
+};
+
+namespace detail {
+
+// Sample k in [0, n) with P(k) proportional to 1 / (k + 1)^s
+class ZipfSampler {
+public:
+    ZipfSampler(uint32_t n, double s) : cdf_(n) {
+        double total = 0;
+        for (uint32_t k = 0; k < n; k++) {
+            total += 1.0 / std::pow(k + 1.0, s);
+            cdf_[k] = total;
+        }
+        for (double& c : cdf_) c /= total;
+    }
+
+    template <typename Rng>
+    uint32_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+        return static_cast<uint32_t>(std::min<size_t>(it - cdf_.begin(), cdf_.size() - 1));
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+} // namespace detail
+
+inline Workload generate_workload(const WorkloadConfig& config) {
+    Workload workload;
+    std::mt19937_64 rng(config.seed);
+    detail::ZipfSampler depth(config.price_levels, config.zipf_exponent);
+    std::uniform_int_distribution<uint32_t> quantity(1, config.max_quantity);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::exponential_distribution<double> gap(config.arrival_rate);
+
+    uint64_t next_id = 1;
+    std::vector<uint64_t> live; // Passive IDs that may still rest
+    live.reserve(config.book_depth + config.operations);
+
+    auto passive = [&]() {
+        Command command{};
+        command.type = CommandType::NewOrder;
+        Order& order = command.order;
+        order.id = next_id++;
+        order.type = OrderType::Limit;
+        order.side = unit(rng) < 0.5 ? Side::Buy : Side::Sell;
+        double ticks = 1.0 + depth(rng); // Never at or through the mid
+        double offset = ticks * config.tick_size;
+        order.price = order.side == Side::Buy ? config.mid_price - offset : config.mid_price + offset;
+        order.price = std::round(order.price / config.tick_size) * config.tick_size;
+        order.quantity = quantity(rng);
+        live.push_back(order.id);
+        return command;
+    };
+
+    workload.setup.reserve(config.book_depth);
+    for (size_t i = 0; i < config.book_depth; i++) {
+        workload.setup.push_back(passive());
+    }
+
+    workload.events.reserve(config.operations);
+    workload.arrival_ns.reserve(config.operations);
+    double clock_ns = 0;
+    for (size_t i = 0; i < config.operations; i++) {
+        clock_ns += gap(rng) * 1e9;
+        workload.arrival_ns.push_back(static_cast<uint64_t>(clock_ns));
+
+        double u = unit(rng);
+        if (u < config.add_ratio || live.empty()) {
+            workload.events.push_back(passive());
+        } else if (u < config.add_ratio + config.cancel_ratio) {
+            // Swap-remove a random live ID
+            size_t pick = static_cast<size_t>(unit(rng) * static_cast<double>(live.size()));
+            pick = std::min(pick, live.size() - 1);
+            Command command{};
+            command.type = CommandType::Cancel;
+            command.order.id = live[pick];
+            live[pick] = live.back();
+            live.pop_back();
+            workload.events.push_back(command);
+        } else {
+            Command command{};
+            command.type = CommandType::NewOrder;
+            command.order.id = next_id++;
+            command.order.type = OrderType::Market;
+            command.order.side = unit(rng) < 0.5 ? Side::Buy : Side::Sell;
+            command.order.price = 0;
+            command.order.quantity = quantity(rng) * config.aggressive_multiplier;
+            workload.events.push_back(command);
+        }
+    }
+    return workload;
+}
+
+} // namespace orderbook
+
+#endif // WORKLOAD_HPP